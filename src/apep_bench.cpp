@@ -0,0 +1,766 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "cxxopts.hpp"
+#include "hydro/Grid.h"
+#include "hydro/PerfCounters.h"
+#include "hydro/Pipeline.h"
+#include "hydro/Reconstruct.h"
+#include "hydro/RiemannSolver.h"
+#include "hydro/Simd.h"
+#include "hydro/Snapshot.h"
+#include "hydro/SnapshotFile.h"
+#include "utils/Settings.h"
+
+static const char *KERNEL_NAMES[] = {
+    "reconstruct_constant", "reconstruct_linear", "riemann_hllc", "riemann_hllc_simd", "riemann_hlle",
+    "fill_halo", "prim_to_cons", "cons_to_prim", "gravity_source", "rk_update", "time_step",
+    "snapshot_write", "snapshot_read",
+};
+
+// Floating point operations of the kernels, counted by hand in Kernels.h, Pipeline.cpp and
+// Grid.cpp. Every add, subtract, multiply, divide, square root, min, max and abs counts as one,
+// compares and selects are free.
+static constexpr double FLUX_DIFFERENCE_FLOPS = 8.0; // Per cell and sweep
+static constexpr double PRIM_TO_CONS_FLOPS = 9.0;
+static constexpr double CONS_TO_PRIM_FLOPS = 9.0;
+static constexpr double GRAVITY_SOURCE_FLOPS = 9.0;
+static constexpr double SIGNAL_RATE_FLOPS = 11.0; // With the running max
+
+// One limited slope of limited_slope
+static double slope_flops(const int limiter) {
+  return limiter == MC ? 10.0 : limiter == VANLEER ? 5.0 : 3.0;
+}
+
+// Left and right states of the four variables at one interface: per variable three
+// differences, two limited slopes and two half slope steps
+static double reconstruct_flops(const int rct, const int limiter) {
+  return rct == CONSTANT ? 0.0 : 4.0 * (7.0 + 2.0 * slope_flops(limiter));
+}
+
+// Flux of one interface. The reference HLLC evaluates both star states and blends them.
+static double riemann_flops(const int rs) {
+  return rs == HLLC ? 94.0 : rs == HLLE ? 105.0 : 60.0;
+}
+
+// Runge-Kutta update of the four conserved variables of one cell, stage 0 has no a1 * q term
+static double update_flops(const int rkstages) {
+  return rkstages == 1 ? 12.0 : 12.0 + 20.0;
+}
+
+// JSON keys of the hardware counters, in PerfCounterType order
+static const char *COUNTER_KEYS[COUNTER_COUNT] = {
+    "cycles", "instructions", "cache_misses", "branch_misses", "fp_vector",
+};
+
+// Timing of one kernel on one grid size
+struct BenchResult {
+  std::string kernel;
+  int nx = 0, ny = 0;
+  long calls = 0; // Calls per batch
+  double seconds = 0.0; // Per call, in the fastest batch
+  double cells = 0.0; // Cells per call
+  double bytes = 0.0; // Per call, from the arrays the kernel has to read and write once
+  double flops = 0.0; // Per call
+  double counts[COUNTER_COUNT] = {}; // Hardware counts per call, in the fastest batch
+  bool counted[COUNTER_COUNT] = {};
+  bool file_io = false; // Bound by the file system, not placed under the roofline
+};
+
+enum MemoryLevel {
+  MEMORY_L1 = 0,
+  MEMORY_L2 = 1,
+  MEMORY_L3 = 2,
+  MEMORY_DRAM = 3,
+  MEMORY_LEVELS,
+};
+
+static const char *MEMORY_LEVEL_NAMES[MEMORY_LEVELS] = {"L1", "L2", "L3", "DRAM"};
+
+// Limits of the machine for the roofline, measured on the solver threads
+struct MachineRoof {
+  // STREAM triad of a working set that fits each level
+  double bytes_per_second[MEMORY_LEVELS] = {};
+  // Bytes each level holds over all solver threads, private caches once per thread
+  double capacity[MEMORY_LEVELS] = {};
+  double flops_per_second = 0.0; // Multiply-adds on full SIMD lanes
+
+  // Fastest level that holds everything a kernel touches in a call, so the one it runs from
+  int Level(const BenchResult &r) const {
+    int level = MEMORY_L1;
+    while (level < MEMORY_DRAM && r.bytes > capacity[level]) {
+      level++;
+    }
+    return level;
+  }
+
+  // FLOPs per byte above which a kernel running from level can be compute bound
+  double Balance(const int level) const {
+    return flops_per_second / bytes_per_second[level];
+  }
+
+  // Share of its roofline a kernel reached: the longer of its time at peak FLOP rate and at
+  // the bandwidth of its level, over the time it took
+  double Fraction(const BenchResult &r) const {
+    return std::max(r.flops / flops_per_second, r.bytes / bytes_per_second[Level(r)]) / r.seconds;
+  }
+
+  bool MemoryBound(const BenchResult &r) const {
+    return r.bytes / bytes_per_second[Level(r)] >= r.flops / flops_per_second;
+  }
+
+  // The roof that limits a kernel. Over 100% it beat the roof of its level, typically by keeping
+  // part of its data in a faster cache than its size suggests, and below half of it something
+  // else holds it back, such as divides, dependencies or the thread pool.
+  const char *Bound(const BenchResult &r) const {
+    const double fraction = Fraction(r);
+    if (fraction > 1.0) {
+      return "above roof";
+    }
+    if (fraction < 0.5) {
+      return "neither";
+    }
+    return MemoryBound(r) ? "memory" : "compute";
+  }
+};
+
+// Data cache size of level 1 to 3 in bytes, for a single core in the private levels. Typical
+// sizes of current x86 cores where the system does not say.
+static double cache_bytes(const int level) {
+  const double fallback[] = {32.0 * 1024, 1024.0 * 1024, 8.0 * 1024 * 1024};
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  const int names[] = {_SC_LEVEL1_DCACHE_SIZE, _SC_LEVEL2_CACHE_SIZE, _SC_LEVEL3_CACHE_SIZE};
+  const long size = sysconf(names[level]);
+  if (size > 0) {
+    return static_cast<double>(size);
+  }
+#endif
+  return fallback[level];
+}
+
+static std::vector<std::string> split(const std::string &list) {
+  std::vector<std::string> items;
+  size_t begin = 0;
+  while (begin <= list.size()) {
+    const size_t end = std::min(list.find(',', begin), list.size());
+    if (end > begin) {
+      items.push_back(list.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return items;
+}
+
+// Seconds per call of the fastest of several batches, each repeating fn for about
+// min_seconds / batches after a calibration call. With counters, counts gets the hardware
+// counts per call of the same batch.
+static double best_seconds(const std::function<void()> &fn, const double min_seconds, long &calls,
+                           const PerfCounters *counters, double *counts) {
+  using Clock = std::chrono::steady_clock;
+  constexpr int batches = 3;
+  auto start = Clock::now();
+  fn();
+  const double once = std::max(std::chrono::duration<double>(Clock::now() - start).count(), 1.0e-9);
+  calls = std::max(1L, static_cast<long>(min_seconds / batches / once));
+  double best = 1.0e30;
+  for (int b = 0; b < batches; b++) {
+    double before[COUNTER_COUNT], after[COUNTER_COUNT];
+    if (counters != nullptr) {
+      counters->Read(before);
+    }
+    start = Clock::now();
+    for (long c = 0; c < calls; c++) {
+      fn();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count() / calls;
+    if (counters != nullptr) {
+      counters->Read(after);
+    }
+    if (seconds < best) {
+      best = seconds;
+      for (int k = 0; counters != nullptr && k < COUNTER_COUNT; k++) {
+        counts[k] = (after[k] - before[k]) / calls;
+      }
+    }
+  }
+  return best;
+}
+
+// STREAM triad a = b + s * c over three arrays of working_set bytes in total, one block of each
+// per solver thread. A thread repeats the triad on its blocks, so they stay in its caches when
+// they fit. Counts 12 bytes per element like STREAM, without the read of a that a
+// write-allocate cache adds.
+static double probe_bandwidth(ThreadPool &pool, const double working_set, const double min_seconds) {
+  const int nthreads = pool.Size();
+  // Floats per array and thread, whole cache lines
+  const size_t block = std::max<size_t>(static_cast<size_t>(working_set / (12.0 * nthreads)) / 16 * 16, 16);
+  const size_t n = block * nthreads;
+  // Enough repeats that the thread pool hand-off is small next to a call
+  const int repeats = static_cast<int>(std::max<size_t>(1, (size_t{1} << 22) / n));
+  std::vector<float> a(n), b(n, 1.0f), c(n, 2.0f);
+  long calls;
+  const double seconds = best_seconds([&] {
+    pool.ParallelFor(0, nthreads, 1, [&](const int t0, const int t1, int) {
+      for (int t = t0; t < t1; t++) {
+        float *pa = a.data() + t * block;
+        const float *pb = b.data() + t * block;
+        const float *pc = c.data() + t * block;
+        for (int r = 0; r < repeats; r++) {
+          for (size_t i = 0; i < block; i++) {
+            pa[i] = pb[i] + 3.0f * pc[i];
+          }
+        }
+      }
+    });
+  }, min_seconds, calls, nullptr, nullptr);
+  return 12.0 * n * repeats / seconds;
+}
+
+// Triad bandwidth of every memory level, each probed with half the bytes it holds so the
+// working set stays resident next to other data. A core only gets a share of a large L3 on a
+// busy or virtual machine, so L3 is taken to hold at most eight times L2. DRAM is probed with
+// four times L3 and at least 192 MiB.
+static void probe_memory(MachineRoof &roof, ThreadPool &pool, const double min_seconds) {
+  const int nthreads = pool.Size();
+  // L3 is shared between the cores, the levels below are private to each
+  roof.capacity[MEMORY_L1] = cache_bytes(MEMORY_L1) * nthreads;
+  roof.capacity[MEMORY_L2] = cache_bytes(MEMORY_L2) * nthreads;
+  roof.capacity[MEMORY_L3] = std::min(cache_bytes(MEMORY_L3), 8.0 * roof.capacity[MEMORY_L2]);
+  roof.capacity[MEMORY_DRAM] = HUGE_VAL;
+  for (int level = MEMORY_L1; level < MEMORY_DRAM; level++) {
+    roof.bytes_per_second[level] = probe_bandwidth(pool, 0.5 * roof.capacity[level], min_seconds);
+  }
+  const double dram_working_set = std::max(4.0 * cache_bytes(MEMORY_L3), 192.0 * 1024 * 1024);
+  roof.bytes_per_second[MEMORY_DRAM] = probe_bandwidth(pool, dram_working_set, min_seconds);
+}
+
+// Bytes as KiB, MiB or GiB
+static std::string byte_size(const double bytes) {
+  const char *units[] = {"B", "KiB", "MiB", "GiB"};
+  int unit = 0;
+  double value = bytes;
+  while (unit < 3 && value >= 1024.0) {
+    value /= 1024.0;
+    unit++;
+  }
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.0f %s", value, units[unit]);
+  return text;
+}
+
+// Independent chains of multiply-adds on full SIMD lanes, enough of them to hide the latency.
+// The compiler fuses them the same way it fuses the kernels, so this is the ceiling of code
+// that only multiplies and adds, divides and square roots are slower.
+static double probe_peak_flops(ThreadPool &pool, const double min_seconds) {
+  constexpr int chains = 12;
+  constexpr long iterations = 1 << 16;
+  const int nthreads = pool.Size();
+  std::vector<float> sums(static_cast<size_t>(nthreads) * SIMD_WIDTH);
+  long calls;
+  const double seconds = best_seconds([&] {
+    pool.ParallelFor(0, nthreads, 1, [&](const int t0, const int t1, int) {
+      for (int t = t0; t < t1; t++) {
+        VFloat acc[chains];
+        for (int k = 0; k < chains; k++) {
+          acc[k] = simd_set1(1.0f + 1.0e-3f * k);
+        }
+        const VFloat mul = simd_set1(0.999999f), add = simd_set1(1.0e-7f);
+        for (long it = 0; it < iterations; it++) {
+          for (int k = 0; k < chains; k++) {
+            acc[k] = acc[k] * mul + add;
+          }
+        }
+        for (int k = 1; k < chains; k++) {
+          acc[0] = acc[0] + acc[k];
+        }
+        // Kept so the chains are not optimized away
+        simd_store(sums.data() + t * SIMD_WIDTH, acc[0]);
+      }
+    });
+  }, min_seconds, calls, nullptr, nullptr);
+  return 2.0 * SIMD_WIDTH * chains * iterations * nthreads / seconds;
+}
+
+// Sum of every value snapshot_read maps, kept so the reads are not optimized away
+static double snapshot_checksum = 0.0;
+
+// Sum of n floats in independent SIMD chains, so the adds keep up with the loads
+static float block_sum(const float *data, const size_t n) {
+  constexpr int chains = 8;
+  VFloat acc[chains];
+  for (VFloat &a: acc) {
+    a = simd_set1(0.0f);
+  }
+  size_t i = 0;
+  for (; i + chains * SIMD_WIDTH <= n; i += chains * SIMD_WIDTH) {
+    for (int k = 0; k < chains; k++) {
+      acc[k] = acc[k] + simd_load(data + i + k * SIMD_WIDTH);
+    }
+  }
+  for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH) {
+    acc[0] = acc[0] + simd_load(data + i);
+  }
+  float sum = 0.0f;
+  for (; i < n; i++) {
+    sum += data[i];
+  }
+  for (const VFloat &a: acc) {
+    sum += simd_hsum(a);
+  }
+  return sum;
+}
+
+// Flushes a written file from the page cache to the disk
+static void sync_file(const std::string &filename) {
+#if defined(__unix__) || defined(__APPLE__)
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+#endif
+}
+
+// Pencil over row j of four fields, pointing into them without a copy
+static void row_view(QVec &q, Field2D *const (&fields)[4], const int j) {
+  q.rho = fields[0]->Row(j);
+  q.u = fields[1]->Row(j);
+  q.v = fields[2]->Row(j);
+  q.en = fields[3]->Row(j);
+  q.n = fields[0]->nx;
+}
+
+// Times every selected kernel on an n * n grid with the RT initial state and prints a line for
+// each to table. The snapshot kernels write and read snapshot_file, fsyncing every write with
+// sync_snapshots. The counters of the calling thread are only read with a single solver thread,
+// where they see all the work. Returns the number of solver threads.
+static int bench_size(const int n, const RTSettings &defaults, const std::vector<std::string> &kernels,
+                      const double min_seconds, const PerfCounters &counters, const std::string &snapshot_file,
+                      const bool sync_snapshots, FILE *table, std::vector<BenchResult> &results) {
+  RTSettings settings = defaults;
+  settings.nx = n;
+  settings.ny = n;
+  Grid grid(settings);
+  ThreadPool &pool = *grid.pool;
+  const PerfCounters *counting = grid.nthreads == 1 && counters.IsOpen() ? &counters : nullptr;
+  const int ng = grid.nghost;
+  const double cells = static_cast<double>(n) * n;
+
+  // Left and right states of every x interface, filled once so the solvers see real states
+  QVec2 left(n + 1, n), right(n + 1, n);
+  Field2D *const prims[4] = {&grid.rho, &grid.u, &grid.v, &grid.en};
+  Field2D *const lefts[4] = {&left.rho, &left.u, &left.v, &left.en};
+  Field2D *const rights[4] = {&right.rho, &right.u, &right.v, &right.en};
+  std::vector<QVec> fluxes(pool.Size());
+  for (QVec &flux: fluxes) {
+    flux.Resize(n + 1);
+  }
+  const auto reconstruct = [&](Reconstructor &rec) {
+    pool.ParallelFor(0, n, 16, [&](const int j0, const int j1, int) {
+      for (int j = j0; j < j1; j++) {
+        QVec q, ql, qr;
+        row_view(q, prims, j + ng);
+        row_view(ql, lefts, j);
+        row_view(qr, rights, j);
+        rec.Reconstruct(q, ql, qr, XDIR);
+      }
+    });
+  };
+  const auto solve = [&](RiemannSolver &solver) {
+    pool.ParallelFor(0, n, 16, [&](const int j0, const int j1, const int thread) {
+      for (int j = j0; j < j1; j++) {
+        QVec ql, qr;
+        row_view(ql, lefts, j);
+        row_view(qr, rights, j);
+        solver.Solve(ql, qr, fluxes[thread], grid.gamma_ad, XDIR);
+      }
+    });
+  };
+  Reconstructor constant(n, n, ng, CONSTANT), linear(n, n, ng, LINEAR, grid.limiter_type);
+  RiemannSolver hllc(n, n, ng, HLLC), hllc_simd(n, n, ng, HLLC_SIMD), hlle(n, n, ng, HLLE);
+  reconstruct(linear);
+
+  std::vector<Tile> &tiles = grid.workspace.tiles;
+  const int ntiles = static_cast<int>(tiles.size());
+  double halo_cells = 0.0;
+  for (const Tile &tile: tiles) {
+    halo_cells += static_cast<double>(tile.nx + 2 * ng) * (tile.ny + 2 * ng);
+  }
+  const double pencil_in = 4.0 * (n + 2 * ng) * n * sizeof(float);
+  const double states = 8.0 * (n + 1) * n * sizeof(float);
+  const double fluxes_out = 4.0 * (n + 1) * n * sizeof(float);
+  // Per time step, every stage reads the primitives and gravity, reads and writes the
+  // conserved state and writes the primitives. The first stage also saves the conserved
+  // state, the second reads it back.
+  const double step_floats = grid.rkstages == 1 ? 18.0 : 40.0;
+  const double interfaces = static_cast<double>(n + 1) * n;
+  // Every stage sweeps both directions, adds gravity, updates and converts back. The first also
+  // converts to conserved, the last one finds the signal rates.
+  const double sweep_flops = reconstruct_flops(grid.reconstruct_type, grid.limiter_type) +
+                             riemann_flops(grid.riemann_solver_type);
+  const double step_flops = grid.rkstages * (2.0 * (interfaces * sweep_flops + cells * FLUX_DIFFERENCE_FLOPS) +
+                                             cells * (GRAVITY_SOURCE_FLOPS + CONS_TO_PRIM_FLOPS)) +
+                            cells * (update_flops(grid.rkstages) + PRIM_TO_CONS_FLOPS +
+                                     (grid.dt_type == DT_CELLS ? SIGNAL_RATE_FLOPS : 0.0));
+  // Tiles hold the halo copy and the residual the source and update kernels work on
+  for (Tile &tile: tiles) {
+    grid.FillHalo(tile);
+  }
+
+  Snapshot snapshot;
+  for (const std::string &name: kernels) {
+    std::function<void()> fn;
+    double bytes = 0.0, flops = 0.0;
+    bool file_io = false;
+    if (name == "reconstruct_constant" || name == "reconstruct_linear") {
+      const bool is_constant = name == "reconstruct_constant";
+      Reconstructor &rec = is_constant ? constant : linear;
+      fn = [&] { reconstruct(rec); };
+      bytes = pencil_in + states;
+      flops = interfaces * reconstruct_flops(is_constant ? CONSTANT : LINEAR, grid.limiter_type);
+    } else if (name == "riemann_hllc" || name == "riemann_hllc_simd" || name == "riemann_hlle") {
+      const int rs = name == "riemann_hllc" ? HLLC : name == "riemann_hlle" ? HLLE : HLLC_SIMD;
+      RiemannSolver &solver = rs == HLLC ? hllc : rs == HLLE ? hlle : hllc_simd;
+      fn = [&] { solve(solver); };
+      bytes = states + fluxes_out;
+      flops = interfaces * riemann_flops(rs);
+    } else if (name == "fill_halo") {
+      fn = [&] {
+        pool.ParallelFor(0, ntiles, 1, [&](const int t0, const int t1, int) {
+          for (int t = t0; t < t1; t++) {
+            grid.FillHalo(tiles[t]);
+          }
+        });
+      };
+      bytes = 8.0 * halo_cells * sizeof(float);
+    } else if (name == "prim_to_cons" || name == "cons_to_prim") {
+      const bool to_cons = name == "prim_to_cons";
+      fn = [&, to_cons] {
+        pool.ParallelFor(0, ntiles, 1, [&](const int t0, const int t1, int) {
+          for (int t = t0; t < t1; t++) {
+            const Tile &tile = tiles[t];
+            if (to_cons) {
+              grid.PrimToCons(tile.i0, tile.i0 + tile.nx, tile.j0, tile.j0 + tile.ny);
+            } else {
+              grid.ConsToPrim(tile.i0, tile.i0 + tile.nx, tile.j0, tile.j0 + tile.ny);
+            }
+          }
+        });
+      };
+      bytes = 8.0 * cells * sizeof(float);
+      flops = cells * (to_cons ? PRIM_TO_CONS_FLOPS : CONS_TO_PRIM_FLOPS);
+    } else if (name == "gravity_source") {
+      fn = [&] {
+        pool.ParallelFor(0, ntiles, 1, [&](const int t0, const int t1, int) {
+          for (int t = t0; t < t1; t++) {
+            grid.GravitySource(tiles[t]);
+          }
+        });
+      };
+      // Gravity and the density and velocities, the three residuals read and written
+      bytes = 11.0 * cells * sizeof(float);
+      flops = cells * GRAVITY_SOURCE_FLOPS;
+    } else if (name == "rk_update") {
+      // A zero residual from the saved state leaves the conserved state as it is, however
+      // often the update runs
+      grid.workspace.cons0 = grid.cons;
+      for (Tile &tile: tiles) {
+        tile.res = QVec2(tile.nx, tile.ny);
+      }
+      const int rkstages = grid.rkstages;
+      fn = [&, rkstages] {
+        pool.ParallelFor(0, ntiles, 1, [&](const int t0, const int t1, int) {
+          for (int t = t0; t < t1; t++) {
+            for (int stage = 0; stage < rkstages; stage++) {
+              UpdateTile(grid, tiles[t], stage);
+            }
+          }
+        });
+      };
+      // Stage 0 reads the saved state and the residual and writes the state, stage 1 also
+      // reads the state
+      bytes = (rkstages == 1 ? 12.0 : 28.0) * cells * sizeof(float);
+      flops = cells * update_flops(rkstages);
+    } else if (name == "snapshot_write" || name == "snapshot_read") {
+      // Both time the whole file, header and padding included. Writes only reach the page cache
+      // unless sync_snapshots flushes each one to the disk. Reads come from the page cache the
+      // writes filled, so they time the mapping and a pass over the data rather than the disk.
+      grid.Capture(snapshot);
+      SnapshotFile file;
+      if (!snapshot.Write(snapshot_file) || !file.Open(snapshot_file)) {
+        continue;
+      }
+      bytes = static_cast<double>(file.header->file_size);
+      file_io = true;
+      if (name == "snapshot_write") {
+        fn = [&] {
+          snapshot.Write(snapshot_file);
+          if (sync_snapshots) {
+            sync_file(snapshot_file);
+          }
+        };
+      } else {
+        fn = [&] {
+          SnapshotFile mapped;
+          mapped.Open(snapshot_file);
+          const FieldView *views[SNAPSHOT_FIELDS] = {&mapped.rho, &mapped.u, &mapped.v, &mapped.en};
+          // Whole blocks, the row padding is part of the file too
+          for (const FieldView *view: views) {
+            snapshot_checksum += block_sum(view->data, static_cast<size_t>(view->stride) * view->ny);
+          }
+        };
+      }
+    } else {
+      fn = [&] { grid.TimeStep(); };
+      bytes = step_floats * cells * sizeof(float);
+      flops = step_flops;
+    }
+    BenchResult result;
+    // Synced writes are a different measurement, so they get their own name in the results
+    result.kernel = name == "snapshot_write" && sync_snapshots ? name + "_sync" : name;
+    result.nx = n;
+    result.ny = n;
+    result.cells = cells;
+    result.bytes = bytes;
+    result.flops = flops;
+    result.file_io = file_io;
+    result.seconds = best_seconds(fn, min_seconds, result.calls, counting, result.counts);
+    for (int k = 0; counting != nullptr && k < COUNTER_COUNT; k++) {
+      result.counted[k] = counting->Available(k);
+    }
+    std::fprintf(table, "%-22s %5d^2 %9.3f ns/cell %10.2f Mzone-cycles/s %8.2f GB/s", result.kernel.c_str(), n,
+                 result.seconds / cells * 1.0e9, cells / result.seconds * 1.0e-6, bytes / result.seconds * 1.0e-9);
+    if (result.counted[COUNTER_INSTRUCTIONS]) {
+      std::fprintf(table, " %5.2f IPC %8.2f instructions/cell", result.counts[COUNTER_INSTRUCTIONS] /
+                   result.counts[COUNTER_CYCLES], result.counts[COUNTER_INSTRUCTIONS] / cells);
+    }
+    std::fprintf(table, "\n");
+    std::fflush(table);
+    results.push_back(result);
+  }
+  return grid.nthreads;
+}
+
+// Where every kernel sits under the roofline of the machine, against the bandwidth of the
+// level its data fits in
+static void print_roofline(FILE *table, const MachineRoof &roof, const std::vector<BenchResult> &results) {
+  std::fprintf(table, "\nRoofline, %.2f GFLOP/s peak\n", roof.flops_per_second * 1.0e-9);
+  for (int level = MEMORY_L1; level <= MEMORY_DRAM; level++) {
+    const std::string capacity = level == MEMORY_DRAM ? "beyond" : "up to " + byte_size(roof.capacity[level]);
+    std::fprintf(table, "%-4s %8.2f GB/s triad, balance %6.2f FLOP/byte, kernels touching %s\n",
+                 MEMORY_LEVEL_NAMES[level], roof.bytes_per_second[level] * 1.0e-9, roof.Balance(level),
+                 capacity.c_str());
+  }
+  std::fprintf(table, "%-22s %7s %9s %8s %8s %9s %5s %8s  %s\n", "kernel", "size", "FLOP/cell", "B/cell", "FLOP/B",
+               "GFLOP/s", "level", "of roof", "bound");
+  for (const BenchResult &r: results) {
+    if (r.file_io) {
+      continue;
+    }
+    std::fprintf(table, "%-22s %5d^2 %9.1f %8.1f %8.3f %9.2f %5s %7.1f%%  %s\n", r.kernel.c_str(), r.nx,
+                 r.flops / r.cells, r.bytes / r.cells, r.flops / r.bytes, r.flops / r.seconds * 1.0e-9,
+                 MEMORY_LEVEL_NAMES[roof.Level(r)], 100.0 * roof.Fraction(r), roof.Bound(r));
+  }
+}
+
+static bool write_json(const std::string &filename, const std::string &label, const RTSettings &settings,
+                       const int nthreads, const double min_seconds, const MachineRoof &roof,
+                       const std::vector<BenchResult> &results) {
+  FILE *file = filename == "-" ? stdout : std::fopen(filename.c_str(), "w");
+  if (file == nullptr) {
+    std::fprintf(stderr, "Error opening file %s\n", filename.c_str());
+    return false;
+  }
+  std::fprintf(file, "{\n  \"benchmark\": \"apep_bench\",\n  \"version\": 4,\n  \"label\": \"");
+  for (const char c: label) {
+    // Labels are commit hashes and short notes, only quotes and backslashes need escaping
+    std::fprintf(file, c == '"' || c == '\\' ? "\\%c" : "%c", c);
+  }
+  std::fprintf(file, "\",\n");
+#ifdef __VERSION__
+  std::fprintf(file, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+  std::fprintf(file, "  \"simd_width\": %d,\n  \"threads\": %d,\n  \"min_time\": %g,\n", SIMD_WIDTH, nthreads,
+               min_seconds);
+  std::fprintf(file, "  \"settings\": {\"nghost\": %d, \"reconstruct_type\": %d, \"limiter_type\": %d, "
+                     "\"riemann_solver_type\": %d, \"rkstages\": %d, \"dt_type\": %d, \"tile_nx\": %d, "
+                     "\"tile_ny\": %d},\n", settings.nghost, settings.reconstruct_type, settings.limiter_type,
+               settings.riemann_solver_type, settings.rkstages, settings.dt_type, settings.tile_nx,
+               settings.tile_ny);
+  // The top level bandwidth and balance are those of DRAM, the levels hold every probe
+  std::fprintf(file, "  \"roofline\": {\"bytes_per_second\": %.6e, \"flops_per_second\": %.6e, "
+                     "\"balance\": %.6g, \"levels\": [", roof.bytes_per_second[MEMORY_DRAM],
+               roof.flops_per_second, roof.Balance(MEMORY_DRAM));
+  for (int level = MEMORY_L1; level <= MEMORY_DRAM; level++) {
+    std::fprintf(file, "%s{\"level\": \"%s\", \"capacity\": ", level > MEMORY_L1 ? ", " : "",
+                 MEMORY_LEVEL_NAMES[level]);
+    if (level == MEMORY_DRAM) {
+      std::fprintf(file, "null");
+    } else {
+      std::fprintf(file, "%.6e", roof.capacity[level]);
+    }
+    std::fprintf(file, ", \"bytes_per_second\": %.6e, \"balance\": %.6g}", roof.bytes_per_second[level],
+                 roof.Balance(level));
+  }
+  std::fprintf(file, "]},\n");
+  std::fprintf(file, "  \"results\": [\n");
+  for (size_t k = 0; k < results.size(); k++) {
+    const BenchResult &r = results[k];
+    std::fprintf(file, "    {\"kernel\": \"%s\", \"nx\": %d, \"ny\": %d, \"calls\": %ld, \"seconds_per_call\": %.6e, "
+                       "\"ns_per_cell\": %.6g, \"zone_cycles_per_second\": %.6e, \"bytes_per_call\": %.6e, "
+                       "\"bytes_per_cell\": %.6g, \"bytes_per_second\": %.6e", r.kernel.c_str(), r.nx, r.ny,
+                 r.calls, r.seconds, r.seconds / r.cells * 1.0e9, r.cells / r.seconds, r.bytes, r.bytes / r.cells,
+                 r.bytes / r.seconds);
+    std::fprintf(file, ", \"flops_per_cell\": %.6g, \"flops_per_second\": %.6e, \"arithmetic_intensity\": %.6g",
+                 r.flops / r.cells, r.flops / r.seconds, r.flops / r.bytes);
+    if (r.file_io) {
+      std::fprintf(file, ", \"roof_level\": null, \"roof_fraction\": null, \"bound\": \"file\"");
+    } else {
+      std::fprintf(file, ", \"roof_level\": \"%s\", \"roof_fraction\": %.6g, \"bound\": \"%s\"",
+                   MEMORY_LEVEL_NAMES[roof.Level(r)], roof.Fraction(r), roof.Bound(r));
+    }
+    // Counts per cell, null where the counter could not be read
+    std::fprintf(file, ", \"counters_per_cell\": {");
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+      std::fprintf(file, "%s\"%s\": ", c > 0 ? ", " : "", COUNTER_KEYS[c]);
+      if (r.counted[c]) {
+        std::fprintf(file, "%.6g", r.counts[c] / r.cells);
+      } else {
+        std::fprintf(file, "null");
+      }
+    }
+    if (r.counted[COUNTER_CYCLES] && r.counted[COUNTER_INSTRUCTIONS]) {
+      std::fprintf(file, "}, \"ipc\": %.4g}%s\n", r.counts[COUNTER_INSTRUCTIONS] / r.counts[COUNTER_CYCLES],
+                   k + 1 < results.size() ? "," : "");
+    } else {
+      std::fprintf(file, "}, \"ipc\": null}%s\n", k + 1 < results.size() ? "," : "");
+    }
+  }
+  std::fprintf(file, "  ]\n}\n");
+  if (file != stdout) {
+    return std::fclose(file) == 0;
+  }
+  return true;
+}
+
+// Times the hydro kernels on square grids with the RT initial state and reports ns per cell,
+// zone-cycles per second and the memory traffic the kernel cannot avoid. Triad bandwidth probes
+// of L1, L2, L3 and DRAM sized working sets and a peak FLOP probe run first, and a roofline
+// summary places every kernel against them from its FLOPs and bytes per cell, with the
+// bandwidth of the level its data fits in. The snapshot kernels time writing and mapping
+// snapshot files instead, in GB/s of file. Pencil kernels run over the x rows of the grid, the
+// others over its tiles, all on the solver thread pool. With one solver thread, IPC and hardware
+// counts per cell are added where perf_event_open allows them.
+// To track results across commits:
+//   apep_bench --json bench.json --label $(git rev-parse --short HEAD)
+int main(int argc, char *argv[]) {
+  const RTSettings defaults;
+  std::string kernel_help = "Comma separated kernels to time, or all:";
+  for (const char *name: KERNEL_NAMES) {
+    kernel_help += std::string(" ") + name;
+  }
+
+  cxxopts::Options options("apep_bench", "Hydro kernel benchmarks");
+  options.add_options()
+      ("sizes", "Comma separated grid sizes, each grid has size^2 cells",
+       cxxopts::value<std::string>()->default_value("64,128,256,512,1024,2048,4096"))
+      ("kernels", kernel_help, cxxopts::value<std::string>()->default_value("all"))
+      ("t,threads", "Solver threads, 0 uses every hardware thread", cxxopts::value<int>()->default_value("1"))
+      ("min-time", "Seconds spent timing each kernel and size", cxxopts::value<float>()->default_value("0.5"))
+      ("json", "JSON results file, - for stdout", cxxopts::value<std::string>()->default_value(""))
+      ("snapshot-file", "Scratch file of the snapshot kernels, removed afterwards",
+       cxxopts::value<std::string>()->default_value("apep_bench.apep"))
+      ("sync", "Flush every snapshot_write to the disk with fsync, to time the disk rather than the page cache",
+       cxxopts::value<bool>()->default_value("false"))
+      ("label", "Free text stored with the JSON results, such as the commit",
+       cxxopts::value<std::string>()->default_value(""))
+      ("reconstruct_type", "0 constant, 1 linear, for time_step", cxxopts::value<int>()->default_value(
+          std::to_string(defaults.reconstruct_type)))
+      ("riemann_solver_type", "0 HLLE, 1 HLLC, 2 vectorized HLLC, for time_step",
+       cxxopts::value<int>()->default_value(std::to_string(defaults.riemann_solver_type)))
+      ("rkstages", "Runge-Kutta stages, for time_step", cxxopts::value<int>()->default_value(
+          std::to_string(defaults.rkstages)))
+      ("tile_nx", "Cells per tile in x", cxxopts::value<int>()->default_value(std::to_string(defaults.tile_nx)))
+      ("tile_ny", "Cells per tile in y", cxxopts::value<int>()->default_value(std::to_string(defaults.tile_ny)))
+      ("h,help", "Show Help");
+  auto result = options.parse(argc, argv);
+  if (result.count("help")) {
+    std::printf("%s\n", options.help().c_str());
+    return EXIT_SUCCESS;
+  }
+
+  RTSettings settings;
+  settings.nghost = 2; // Enough for either reconstruction
+  settings.nthreads = result["threads"].as<int>();
+  settings.reconstruct_type = result["reconstruct_type"].as<int>();
+  settings.riemann_solver_type = result["riemann_solver_type"].as<int>();
+  settings.rkstages = result["rkstages"].as<int>();
+  settings.tile_nx = result["tile_nx"].as<int>();
+  settings.tile_ny = result["tile_ny"].as<int>();
+  const double min_seconds = result["min-time"].as<float>();
+
+  std::vector<int> sizes;
+  for (const std::string &size: split(result["sizes"].as<std::string>())) {
+    const int n = std::atoi(size.c_str());
+    if (n <= 0) {
+      std::fprintf(stderr, "Bad grid size %s\n", size.c_str());
+      return EXIT_FAILURE;
+    }
+    sizes.push_back(n);
+  }
+  std::vector<std::string> kernels = split(result["kernels"].as<std::string>());
+  if (kernels.size() == 1 && kernels[0] == "all") {
+    kernels.assign(std::begin(KERNEL_NAMES), std::end(KERNEL_NAMES));
+  }
+  for (const std::string &name: kernels) {
+    if (std::find(std::begin(KERNEL_NAMES), std::end(KERNEL_NAMES), name) == std::end(KERNEL_NAMES)) {
+      std::fprintf(stderr, "Unknown kernel %s\n", name.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  const std::string json = result["json"].as<std::string>();
+  // JSON on stdout moves the table to stderr
+  FILE *table = json == "-" ? stderr : stdout;
+  std::vector<BenchResult> results;
+  int nthreads = settings.nthreads;
+  PerfCounters counters;
+  if (!counters.Open()) {
+    std::fprintf(table, "No hardware counters, see perf_event_paranoid\n");
+  }
+  MachineRoof roof;
+  {
+    ThreadPool pool(nthreads > 0 ? nthreads : std::max(1u, std::thread::hardware_concurrency()));
+    probe_memory(roof, pool, min_seconds);
+    roof.flops_per_second = probe_peak_flops(pool, min_seconds);
+  }
+  for (int level = MEMORY_L1; level <= MEMORY_DRAM; level++) {
+    std::fprintf(table, "%.2f GB/s %s triad, ", roof.bytes_per_second[level] * 1.0e-9, MEMORY_LEVEL_NAMES[level]);
+  }
+  std::fprintf(table, "%.2f GFLOP/s peak\n", roof.flops_per_second * 1.0e-9);
+  const std::string snapshot_file = result["snapshot-file"].as<std::string>();
+  const bool sync_snapshots = result["sync"].as<bool>();
+  for (const int n: sizes) {
+    nthreads = bench_size(n, settings, kernels, min_seconds, counters, snapshot_file, sync_snapshots, table,
+                          results);
+  }
+  std::remove(snapshot_file.c_str());
+  print_roofline(table, roof, results);
+  const std::string label = result["label"].as<std::string>();
+  if (!json.empty() && !write_json(json, label, settings, nthreads, min_seconds, roof, results)) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "cxxopts.hpp"
+#include "hydro/Checkpoint.h"
+#include "hydro/Colormap.h"
+#include "hydro/Diagnostics.h"
+#include "hydro/FrameWriter.h"
+#include "hydro/Grid.h"
+#include "hydro/SnapshotFile.h"
+#include "hydro/SnapshotWriter.h"
+#include "utils/Settings.h"
+#include "utils/Trace.h"
+
+// Colormapped frames of one field, written as numbered images or appended to one video stream
+struct FrameOutput {
+  std::string prefix;
+  std::string format; // ppm, qoi or y4m
+  int field = 0; // rho, u, v, en
+  int width = 0, height = 0;
+  float scale_min = 0.0f, scale_max = 0.0f;
+  int resample = RESAMPLE_NEAREST;
+  ColormapLut lut;
+  FrameRenderer renderer;
+  Y4mWriter video;
+
+  // Renders and writes one frame, on one thread at a time
+  bool Write(const Snapshot &snapshot) {
+    const Field2D *fields[4] = {&snapshot.rho, &snapshot.u, &snapshot.v, &snapshot.en};
+    renderer.Render(*fields[field], snapshot.nx, snapshot.ny, width, height, lut, scale_min, scale_max, resample);
+    if (format == "y4m") {
+      return video.Write(renderer.rgb.data());
+    }
+    const std::string filename = SnapshotFilename(prefix + "_{step}." + format, snapshot.step);
+    if (format == "ppm") {
+      return WritePPM(filename, renderer.width, renderer.height, renderer.rgb.data());
+    }
+    return WriteQOI(filename, renderer.width, renderer.height, renderer.rgb.data());
+  }
+};
+
+// Signal that asked the run to stop, handled after the current step
+static volatile std::sig_atomic_t stop_signal = 0;
+
+static void request_stop(const int signal) {
+  stop_signal = signal;
+  // A second one stops the run right away
+  std::signal(signal, SIG_DFL);
+}
+
+// Runs the RT instability to tmax without a window or GL context, writing snapshots and a
+// diagnostics table as it goes. Every RTSettings value can be set from the command line:
+//   apep_run --nx 256 --ny 768 --tmax 10 --output-dt 1
+// Colormapped frames need no GL either:
+//   apep_run --frames rt --frame-format y4m --frame-dt 0.05 && ffmpeg -i rt.y4m rt.mp4
+// With APEP_WITH_MPI the grid rows are split over the ranks of mpirun -np N.
+// SIGTERM or SIGINT write a checkpoint and stop, and the run continues bit for bit with
+//   apep_run --restart checkpoint.ckpt --tmax 20
+static int run(int argc, char *argv[]) {
+  const RTSettings defaults;
+  const auto int_value = [](const int value) { return cxxopts::value<int>()->default_value(std::to_string(value)); };
+  const auto float_value = [](const float value) {
+    return cxxopts::value<float>()->default_value(std::to_string(value));
+  };
+
+  cxxopts::Options options("apep_run", "Headless RT instability run");
+  options.add_options("Grid")
+      ("nx", "Cells in x", int_value(defaults.nx))
+      ("ny", "Cells in y", int_value(defaults.ny))
+      ("nghost", "Ghost cells, raised to what the reconstruction needs", int_value(defaults.nghost))
+      ("x1", "Left edge", float_value(defaults.x1))
+      ("x2", "Right edge", float_value(defaults.x2))
+      ("y1", "Bottom edge", float_value(defaults.y1))
+      ("y2", "Top edge", float_value(defaults.y2));
+  options.add_options("Initial conditions")
+      ("rho_ini_upper", "Density of the upper fluid", float_value(defaults.rho_ini_upper))
+      ("rho_ini_lower", "Density of the lower fluid", float_value(defaults.rho_ini_lower))
+      ("en_ini", "Pressure at y = 0", float_value(defaults.en_ini))
+      ("grav_x_ini", "Gravity in x", float_value(defaults.grav_x_ini))
+      ("grav_y_ini", "Gravity in y", float_value(defaults.grav_y_ini))
+      ("perturb_strength", "Amplitude of the velocity perturbation", float_value(defaults.perturb_strength));
+  options.add_options("Solver")
+      ("tmax", "End time", float_value(defaults.tmax))
+      ("cfl", "CFL number", float_value(defaults.cfl))
+      ("dt_type", "0 fixed, 1 from cell signal speeds, 2 from Riemann wave speeds", int_value(defaults.dt_type))
+      ("dt_growth", "Largest factor dt may grow by per step", float_value(defaults.dt_growth))
+      ("gamma_ad", "Adiabatic index", float_value(defaults.gamma_ad))
+      ("reconstruct_type", "0 constant, 1 linear", int_value(defaults.reconstruct_type))
+      ("limiter_type", "0 minmod, 1 MC, 2 van Leer", int_value(defaults.limiter_type))
+      ("riemann_solver_type", "0 HLLE, 1 HLLC, 2 vectorized HLLC", int_value(defaults.riemann_solver_type))
+      ("rkstages", "Runge-Kutta stages, 1 or 2", int_value(defaults.rkstages))
+      ("t,nthreads", "Solver threads, 0 uses every hardware thread", int_value(defaults.nthreads))
+      ("tile_nx", "Cells per tile in x", int_value(defaults.tile_nx))
+      ("tile_ny", "Cells per tile in y", int_value(defaults.tile_ny));
+  options.add_options("Refinement")
+      ("amr", "Refine blocks flagged by the criterion by a factor 2", int_value(defaults.amr))
+      ("amr_block", "Cells per block side, must divide nx and ny", int_value(defaults.amr_block))
+      ("amr_criterion", "0 density gradient, 1 interface between the fluids", int_value(defaults.amr_criterion))
+      ("amr_threshold", "Relative density jump, or mixed fraction for the interface criterion",
+       float_value(defaults.amr_threshold))
+      ("amr_regrid", "Steps between regrids", int_value(defaults.amr_regrid));
+  options.add_options("Output")
+      ("o,output", "Snapshot file name, {step} is replaced by the step number",
+       cxxopts::value<std::string>()->default_value("grid_{step}.apep"))
+      ("output-dt", "Simulation time between snapshots, 0 only writes the final state",
+       cxxopts::value<float>()->default_value("0"))
+      ("trace", "Chrome trace of the run written at exit, .rank<N> is appended with several ranks",
+       cxxopts::value<std::string>()->default_value(""))
+      ("diagnostics", "Diagnostics table, empty to disable",
+       cxxopts::value<std::string>()->default_value("diagnostics.csv"))
+      ("diagnostics-every", "Steps between diagnostics rows", cxxopts::value<int>()->default_value("10"))
+      ("diagnostics-format", "Diagnostics table as csv or binary records, see Diagnostics.h",
+       cxxopts::value<std::string>()->default_value("csv"))
+      ("writer-buffers", "Snapshots queued for the writer thread, 0 writes on the stepping thread",
+       cxxopts::value<int>()->default_value("4"))
+      ("backpressure", "When the writer falls behind: block, drop or decimate",
+       cxxopts::value<std::string>()->default_value("block"))
+      ("h,help", "Show Help");
+  options.add_options("Checkpoint")
+      ("restart", "Checkpoint to continue from, its settings replace the grid, solver and refinement options",
+       cxxopts::value<std::string>()->default_value(""))
+      ("checkpoint", "Checkpoint file name, {step} is replaced by the step number, empty for no checkpoints",
+       cxxopts::value<std::string>()->default_value("checkpoint.ckpt"))
+      ("checkpoint-steps", "Steps between checkpoints, 0 for none", cxxopts::value<int>()->default_value("0"))
+      ("checkpoint-seconds", "Wall-clock seconds between checkpoints, 0 for none",
+       cxxopts::value<float>()->default_value("0"));
+  options.add_options("Frames")
+      ("frames", "Frame file prefix, empty for no frames", cxxopts::value<std::string>()->default_value(""))
+      ("frame-format", "ppm or qoi images <prefix>_<step>.<format>, or y4m for one <prefix>.y4m video",
+       cxxopts::value<std::string>()->default_value("qoi"))
+      ("frame-dt", "Simulation time between frames", cxxopts::value<float>()->default_value("0.1"))
+      ("frame-field", "rho, u, v or en", cxxopts::value<std::string>()->default_value("rho"))
+      ("frame-width", "Frame width, 0 follows the height or the grid", cxxopts::value<int>()->default_value("0"))
+      ("frame-height", "Frame height, 0 follows the width or the grid", cxxopts::value<int>()->default_value("0"))
+      ("frame-min", "Value at the low end of the colormap", cxxopts::value<float>()->default_value("0"))
+      ("frame-max", "Value at the high end of the colormap", cxxopts::value<float>()->default_value("3"))
+      ("colormap", "ImPlot colormap name", cxxopts::value<std::string>()->default_value("Viridis"))
+      ("resample", "nearest or bilinear", cxxopts::value<std::string>()->default_value("nearest"))
+      ("fps", "Frame rate of the y4m video", cxxopts::value<int>()->default_value("30"));
+  auto result = options.parse(argc, argv);
+  // Before the grid, so help needs no memory or threads and works whatever the decomposition
+  if (result.count("help")) {
+    if (DomainRank() == 0) {
+      std::printf("%s\n", options.help().c_str());
+    }
+    return EXIT_SUCCESS;
+  }
+
+  RTSettings settings;
+  settings.nx = result["nx"].as<int>();
+  settings.ny = result["ny"].as<int>();
+  settings.nghost = result["nghost"].as<int>();
+  settings.x1 = result["x1"].as<float>();
+  settings.x2 = result["x2"].as<float>();
+  settings.y1 = result["y1"].as<float>();
+  settings.y2 = result["y2"].as<float>();
+  settings.rho_ini_upper = result["rho_ini_upper"].as<float>();
+  settings.rho_ini_lower = result["rho_ini_lower"].as<float>();
+  settings.en_ini = result["en_ini"].as<float>();
+  settings.grav_x_ini = result["grav_x_ini"].as<float>();
+  settings.grav_y_ini = result["grav_y_ini"].as<float>();
+  settings.perturb_strength = result["perturb_strength"].as<float>();
+  settings.tmax = result["tmax"].as<float>();
+  settings.cfl = result["cfl"].as<float>();
+  settings.dt_type = result["dt_type"].as<int>();
+  settings.dt_growth = result["dt_growth"].as<float>();
+  settings.gamma_ad = result["gamma_ad"].as<float>();
+  settings.reconstruct_type = result["reconstruct_type"].as<int>();
+  settings.limiter_type = result["limiter_type"].as<int>();
+  settings.riemann_solver_type = result["riemann_solver_type"].as<int>();
+  settings.rkstages = result["rkstages"].as<int>();
+  settings.nthreads = result["nthreads"].as<int>();
+  settings.tile_nx = result["tile_nx"].as<int>();
+  settings.tile_ny = result["tile_ny"].as<int>();
+  settings.amr = result["amr"].as<int>();
+  settings.amr_block = result["amr_block"].as<int>();
+  settings.amr_criterion = result["amr_criterion"].as<int>();
+  settings.amr_threshold = result["amr_threshold"].as<float>();
+  settings.amr_regrid = result["amr_regrid"].as<int>();
+  const std::string output = result["output"].as<std::string>();
+  const float output_dt = result["output-dt"].as<float>();
+  const std::string diagnostics_file = result["diagnostics"].as<std::string>();
+  const int diagnostics_every = std::max(1, result["diagnostics-every"].as<int>());
+  const std::string diagnostics_format = result["diagnostics-format"].as<std::string>();
+  const int writer_buffers = result["writer-buffers"].as<int>();
+  const std::string backpressure_name = result["backpressure"].as<std::string>();
+  const char *backpressure_names[3] = {"block", "drop", "decimate"};
+  const int backpressure =
+      static_cast<int>(std::find(backpressure_names, backpressure_names + 3, backpressure_name) - backpressure_names);
+
+  FrameOutput frames;
+  frames.prefix = result["frames"].as<std::string>();
+  frames.format = result["frame-format"].as<std::string>();
+  const float frame_dt = result["frame-dt"].as<float>();
+  const std::string field_name = result["frame-field"].as<std::string>();
+  const std::string colormap = result["colormap"].as<std::string>();
+  const std::string resample = result["resample"].as<std::string>();
+  const char *field_names[4] = {"rho", "u", "v", "en"};
+  frames.field = static_cast<int>(std::find(field_names, field_names + 4, field_name) - field_names);
+  frames.scale_min = result["frame-min"].as<float>();
+  frames.scale_max = result["frame-max"].as<float>();
+  frames.resample = resample == "bilinear" ? RESAMPLE_BILINEAR : RESAMPLE_NEAREST;
+
+  const std::string restart = result["restart"].as<std::string>();
+  const std::string checkpoint = result["checkpoint"].as<std::string>();
+  const int checkpoint_steps = result["checkpoint-steps"].as<int>();
+  const double checkpoint_seconds = result["checkpoint-seconds"].as<float>();
+  if (!restart.empty() && !ReadCheckpointSettings(restart, settings)) {
+    return EXIT_FAILURE;
+  }
+
+  Grid grid(settings);
+  const bool root = grid.domain.rank == 0;
+  if (settings.amr && !grid.amr.enabled) {
+    // Every rank sees the same layout, so they all stop here
+    if (root) {
+      std::fprintf(stderr, "Error: --amr 1 cannot run, %s (amr_block %d, nx %d, ny %d, %d ranks)\n",
+                   Amr::Unsupported(grid.domain.size, grid.nx, grid.domain.ny_global, grid.amr.block),
+                   grid.amr.block, grid.nx, grid.domain.ny_global, grid.domain.size);
+    }
+    return EXIT_FAILURE;
+  }
+  // Destroyed after the writer below, so the trace has every write in it however the run ends
+  struct TraceOutput {
+    std::string filename;
+    int rank = 0;
+
+    ~TraceOutput() {
+      if (!filename.empty()) {
+        GlobalTrace().Write(filename, rank);
+      }
+    }
+  } trace_output;
+  trace_output.filename = result["trace"].as<std::string>();
+  trace_output.rank = grid.domain.rank;
+  if (!trace_output.filename.empty()) {
+    if (grid.domain.size > 1) {
+      trace_output.filename += ".rank" + std::to_string(grid.domain.rank);
+    }
+    TraceThreadName("Main");
+    GlobalTrace().Start();
+  }
+  if (!restart.empty() && !grid.ReadCheckpoint(restart)) {
+    return EXIT_FAILURE;
+  }
+  if (!checkpoint.empty()) {
+    std::signal(SIGTERM, request_stop);
+    std::signal(SIGINT, request_stop);
+  }
+  if (backpressure == 3) {
+    std::fprintf(stderr, "Unknown backpressure %s\n", backpressure_name.c_str());
+    return EXIT_FAILURE;
+  }
+  const bool write_frames = !frames.prefix.empty();
+  if (write_frames) {
+    if (frames.format != "ppm" && frames.format != "qoi" && frames.format != "y4m") {
+      std::fprintf(stderr, "Unknown frame format %s\n", frames.format.c_str());
+      return EXIT_FAILURE;
+    }
+    if (frames.field == 4 || ColormapIndex(colormap) < 0 || (resample != "nearest" && resample != "bilinear")) {
+      std::fprintf(stderr, "Unknown frame field, colormap or resampling\n");
+      return EXIT_FAILURE;
+    }
+    frames.lut = ColormapLut(ColormapIndex(colormap));
+    // A missing side keeps the aspect ratio of the grid, which AMR may show at a finer resolution
+    const int refinement = grid.amr.enabled ? AMR_RATIO : 1;
+    const int nx = grid.nx * refinement, ny = grid.domain.ny_global * refinement;
+    frames.width = result["frame-width"].as<int>();
+    frames.height = result["frame-height"].as<int>();
+    if (frames.width <= 0 && frames.height <= 0) {
+      frames.width = nx;
+      frames.height = ny;
+    } else if (frames.width <= 0) {
+      frames.width = std::max(1, frames.height * nx / ny);
+    } else if (frames.height <= 0) {
+      frames.height = std::max(1, frames.width * ny / nx);
+    }
+    if (root && frames.format == "y4m" &&
+        !frames.video.Open(frames.prefix + ".y4m", frames.width, frames.height, result["fps"].as<int>())) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Reduced on every rank, written by rank 0
+  const bool write_diagnostics = !diagnostics_file.empty();
+  DiagnosticsReducer reducer;
+  DiagnosticsFile diagnostics;
+  if (write_diagnostics && diagnostics_format != "csv" && diagnostics_format != "binary") {
+    std::fprintf(stderr, "Unknown diagnostics format %s, expected csv or binary\n", diagnostics_format.c_str());
+    return EXIT_FAILURE;
+  }
+  // A restarted run continues the table of the run it came from
+  if (root && write_diagnostics &&
+      !diagnostics.Open(diagnostics_file, diagnostics_format == "binary", !restart.empty())) {
+    return EXIT_FAILURE;
+  }
+  if (root) {
+    std::printf("%d x %d cells to t = %.3f on %d rank(s) with %d thread(s) each\n", grid.nx, grid.domain.ny_global,
+                settings.tmax, grid.domain.size, grid.nthreads);
+  }
+
+  // Output runs on the writer thread of rank 0 while the grid keeps stepping
+  std::unique_ptr<SnapshotWriter> writer;
+  if (root && writer_buffers > 0) {
+    writer = std::make_unique<SnapshotWriter>(writer_buffers, backpressure);
+  }
+  Snapshot scratch; // Capture target of the other ranks, and of rank 0 without a writer
+  const auto write_snapshot = [&output](const Snapshot &snapshot) {
+    return snapshot.Write(SnapshotFilename(output, snapshot.step));
+  };
+  const auto write_frame = [&frames](const Snapshot &snapshot) { return frames.Write(snapshot); };
+  // Captures the grid and queues write for it. Collective, every rank learns whether rank 0
+  // skipped the output and gets false once a write has failed.
+  const auto submit = [&](SnapshotWriter::WriteFunction write, const bool required) {
+    float state = 1.0f; // -1 a write failed, 0 skip this output, 1 capture
+    Snapshot *buffer = &scratch;
+    if (writer != nullptr && writer->Stats().failed > 0) {
+      state = -1.0f;
+    } else if (writer != nullptr) {
+      buffer = writer->Acquire(required);
+      state = buffer != nullptr ? 1.0f : 0.0f;
+    }
+    state = grid.domain.GlobalMin(state);
+    if (state <= 0.0f) {
+      return state == 0.0f;
+    }
+    {
+      APEP_TRACE_SCOPE("Capture");
+      grid.Capture(*buffer);
+    }
+    if (writer != nullptr) {
+      writer->Submit(buffer, std::move(write));
+    }
+    if (writer_buffers > 0) {
+      return true;
+    }
+    const bool ok = !root || write(*buffer);
+    return grid.domain.GlobalMin(ok ? 1.0f : 0.0f) > 0.0f;
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  auto last = start;
+  auto last_checkpoint = start;
+  const long first_step = grid.step;
+  long last_step = first_step;
+  // A restarted run picks up the output schedule where the checkpoint left it
+  float next_output = output_dt;
+  float next_frame = frame_dt;
+  while (output_dt > 0.0f && next_output <= grid.time) {
+    next_output += output_dt;
+  }
+  while (frame_dt > 0.0f && next_frame <= grid.time) {
+    next_frame += frame_dt;
+  }
+  if (write_frames && restart.empty() && !submit(write_frame, true)) {
+    return EXIT_FAILURE;
+  }
+  if (write_diagnostics && restart.empty()) {
+    const Diagnostics d = reducer.Reduce(grid);
+    if (root) {
+      diagnostics.Write(d);
+    }
+  }
+  while (grid.time < settings.tmax) {
+    grid.TimeStep(settings.tmax);
+    if (write_frames && frame_dt > 0.0f && grid.time >= next_frame && grid.time < settings.tmax) {
+      if (!submit(write_frame, false)) {
+        return EXIT_FAILURE;
+      }
+      next_frame += frame_dt;
+    }
+    if (output_dt > 0.0f && grid.time >= next_output && grid.time < settings.tmax) {
+      if (!submit(write_snapshot, false)) {
+        return EXIT_FAILURE;
+      }
+      next_output += output_dt;
+    }
+    // The last step always gets a row, so the diagnostics end at tmax too
+    if (write_diagnostics && (grid.step % diagnostics_every == 0 || grid.time >= settings.tmax)) {
+      APEP_TRACE_SCOPE("Diagnostics");
+      Diagnostics d = reducer.Reduce(grid);
+      const auto now = std::chrono::steady_clock::now();
+      const double interval = std::chrono::duration<double>(now - last).count();
+      const double zone_cycles = static_cast<double>(grid.nx) * grid.domain.ny_global * (grid.step - last_step);
+      const WriterStats stats = writer != nullptr ? writer->Stats() : WriterStats();
+      d.wall_seconds = std::chrono::duration<double>(now - start).count();
+      d.zone_cycles_per_second = zone_cycles / interval;
+      d.write_queue_depth = stats.queue_depth;
+      d.write_latency = stats.last_latency;
+      if (root) {
+        diagnostics.Write(d);
+      }
+      last = now;
+      last_step = grid.step;
+    }
+    if (!checkpoint.empty()) {
+      // Agreed over the ranks: 0 a signal arrived, 1 a checkpoint is due, 2 keep going
+      const auto now = std::chrono::steady_clock::now();
+      const bool due = (checkpoint_steps > 0 && grid.step % checkpoint_steps == 0) ||
+                       (checkpoint_seconds > 0.0 &&
+                        std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_seconds);
+      const float state = grid.domain.GlobalMin(stop_signal != 0 ? 0.0f : due ? 1.0f : 2.0f);
+      if (state < 2.0f) {
+        APEP_TRACE_SCOPE("Checkpoint");
+        if (!grid.WriteCheckpoint(SnapshotFilename(checkpoint, grid.step))) {
+          return EXIT_FAILURE;
+        }
+        last_checkpoint = now;
+      }
+      if (state == 0.0f) {
+        if (root) {
+          std::printf("Stopped at t = %.4f after %ld steps, continue with --restart %s\n", grid.time, grid.step,
+                      SnapshotFilename(checkpoint, grid.step).c_str());
+        }
+        return 128 + (stop_signal != 0 ? stop_signal : SIGTERM);
+      }
+    }
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (!submit(write_snapshot, true) || (write_frames && !submit(write_frame, true))) {
+    return EXIT_FAILURE;
+  }
+  if (writer != nullptr) {
+    writer->Flush();
+  }
+
+  diagnostics.Close();
+  if (root) {
+    const double zone_cycles = static_cast<double>(grid.nx) * grid.domain.ny_global * (grid.step - first_step);
+    std::printf("t = %.4f after %ld steps in %.3f s, %.2f Mzone-cycles/s\n", grid.time, grid.step, seconds,
+                zone_cycles / seconds * 1.0e-6);
+  }
+  if (writer != nullptr) {
+    const WriterStats stats = writer->Stats();
+    std::printf("Wrote %ld outputs, dropped %ld, queue depth up to %d, latency %.3f s mean and %.3f s max, "
+                "stepping blocked %.3f s\n", stats.written, stats.dropped, stats.max_queue_depth,
+                stats.total_latency / std::max(stats.written + stats.failed, 1L), stats.max_latency,
+                stats.blocked_seconds);
+    if (stats.failed > 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  DomainInit(&argc, &argv);
+  // The grid and its threads are gone before MPI shuts down
+  const int status = run(argc, argv);
+  DomainFinalize();
+  return status;
+}
@@ -8,6 +8,7 @@
 #include <iostream>
 
 #include "cxxopts.hpp"
+#include "Trace.h"
 
 void StyeColorsApp() {
     static constexpr auto bg_dark = ImVec4(0.15f, 0.16f, 0.21f, 1.00f);
@@ -123,6 +124,8 @@ App::App(std::string title, int w, int h, int argc, char const *argv[]) {
         ("h,height", "Window height override",cxxopts::value<int>())
         ("g,gpu", "Use discrete GPU on hybrid laptops")
         ("help","Show Help");
+    // Applications parse their own options from the same command line
+    options.allow_unrecognised_options();
 
     auto result = options.parse(argc,argv);
     if (result.count("help")) {
@@ -229,15 +232,21 @@ App::~App() {
 }
 
 void App::Run() {
+    TraceThreadName("Main");
     Start();
     while (!glfwWindowShouldClose(Window)) {
+        APEP_TRACE_SCOPE("Frame");
         glfwPollEvents();
         // Start the Dear ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
-        Update();
+        {
+            APEP_TRACE_SCOPE("Update");
+            Update();
+        }
         // Rendering
+        APEP_TRACE_SCOPE("Render");
         ImGui::Render();
         int display_w, display_h;
         glfwGetFramebufferSize(Window, &display_w, &display_h);
@@ -0,0 +1,441 @@
+#include "Amr.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Grid.h"
+#include "Snapshot.h"
+
+// Limited slope from the differences to the left and right neighbour
+static float minmod(const float a, const float b) {
+    if (a * b <= 0.0f) {
+        return 0.0f;
+    }
+    return std::abs(a) < std::abs(b) ? a : b;
+}
+
+// Offset of fine cell f from the centre of its coarse cell, in coarse cell widths
+static float fine_offset(const int f) {
+    return (f % AMR_RATIO + 0.5f) / AMR_RATIO - 0.5f;
+}
+
+void Patch::Resize(const int block, const int nghost) {
+    const int n = AMR_RATIO * block;
+    tile.Resize(0, 0, n, n, nghost);
+    cons.Resize(n, n);
+    cons0.Resize(n, n);
+    gx.Resize(n, n);
+    gy.Resize(n, n);
+    flux_x.Resize(block, 2);
+    flux_y.Resize(block, 2);
+}
+
+const char *Amr::Unsupported(const int ranks, const int nx, const int ny, const int block) {
+    // Patch halos are filled from the coarse level directly, which is not split over ranks
+    if (ranks > 1) {
+        return "refinement needs the whole grid on a single MPI rank";
+    }
+    if (block < 1 || nx % block != 0 || ny % block != 0) {
+        return "amr_block must divide nx and ny";
+    }
+    return nullptr;
+}
+
+void Amr::Configure(const Grid &g, const bool requested, const int block, const int criterion,
+                    const float threshold, const int regrid_interval) {
+    this->block = std::max(block, 1);
+    this->criterion = criterion;
+    this->threshold = threshold;
+    this->regrid_interval = std::max(regrid_interval, 1);
+    this->nghost = g.nghost;
+    enabled = requested && Unsupported(g.domain.size, g.nx, g.ny, this->block) == nullptr;
+    patches.clear();
+    active.clear();
+    spare.clear();
+    if (!enabled) {
+        nbx = nby = 0;
+        patch_of_block.clear();
+        flags.clear();
+        prim_old = QVec2();
+        flux_x = QVec2();
+        flux_y = QVec2();
+        return;
+    }
+    nbx = g.nx / this->block;
+    nby = g.ny / this->block;
+    patch_of_block.assign(static_cast<size_t>(nbx) * nby, -1);
+    flags.assign(patch_of_block.size(), 0);
+    prim_old.Resize(g.nx, g.ny);
+    flux_x.Resize(nbx, g.ny);
+    flux_y.Resize(g.nx, nby);
+}
+
+bool Amr::NeedsRefinement(const Grid &g, const int bi, const int bj) const {
+    const int ng = g.nghost;
+    const float lower = std::min(g.rho_ini_lower, g.rho_ini_upper);
+    const float upper = std::max(g.rho_ini_lower, g.rho_ini_upper);
+    const float range = std::max(upper - lower, 1.0e-6f);
+    for (int j = bj * block; j < (bj + 1) * block; j++) {
+        for (int i = bi * block; i < (bi + 1) * block; i++) {
+            // Right and upper neighbour, periodic in x and stopping at the upper wall
+            const float r = g.rho(i + ng, j + ng);
+            const float rx = g.rho((i + 1) % g.nx + ng, j + ng);
+            const float ry = g.rho(i + ng, std::min(j + 1, g.ny - 1) + ng);
+            if (criterion == REFINE_INTERFACE) {
+                // Partly mixed cells, or a sharp interface between a cell and its neighbour
+                const float f = (r - lower) / range;
+                const bool heavy = f >= 0.5f;
+                if ((f > threshold && f < 1.0f - threshold) || heavy != ((rx - lower) / range >= 0.5f) ||
+                    heavy != ((ry - lower) / range >= 0.5f)) {
+                    return true;
+                }
+            } else if (std::max(std::abs(rx - r), std::abs(ry - r)) > threshold * r) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Amr::Regrid(Grid &g) {
+    for (int bj = 0; bj < nby; bj++) {
+        for (int bi = 0; bi < nbx; bi++) {
+            flags[bj * nbx + bi] = NeedsRefinement(g, bi, bj);
+        }
+    }
+    // Refine one block around every flagged block, so features stay on the fine level until
+    // the next regrid
+    for (int bj = 0; bj < nby; bj++) {
+        for (int bi = 0; bi < nbx; bi++) {
+            bool refine = false;
+            for (int dj = -1; dj <= 1 && !refine; dj++) {
+                for (int di = -1; di <= 1 && !refine; di++) {
+                    const int nj = bj + dj;
+                    refine = nj >= 0 && nj < nby && (flags[nj * nbx + (bi + di + nbx) % nbx] & 1);
+                }
+            }
+            if (refine) {
+                flags[bj * nbx + bi] |= 2;
+            }
+        }
+    }
+    active.clear();
+    for (int b = 0; b < nbx * nby; b++) {
+        int &p = patch_of_block[b];
+        const bool refine = flags[b] & 2;
+        if (!refine && p >= 0) {
+            // The coarse cells already hold the average of the fine ones
+            spare.push_back(p);
+            p = -1;
+        } else if (refine && p < 0) {
+            p = NewPatch();
+            Prolong(g, patches[p], b % nbx, b / nbx);
+        }
+        if (p >= 0) {
+            active.push_back(p);
+        }
+    }
+}
+
+void Amr::SetPatches(const Grid &g, const std::vector<int> &blocks) {
+    for (int &p: patch_of_block) {
+        if (p >= 0) {
+            spare.push_back(p);
+            p = -1;
+        }
+    }
+    active.clear();
+    for (const int b: blocks) {
+        const int p = NewPatch();
+        patch_of_block[b] = p;
+        Prolong(g, patches[p], b % nbx, b / nbx);
+        active.push_back(p);
+    }
+}
+
+int Amr::NewPatch() {
+    if (!spare.empty()) {
+        const int p = spare.back();
+        spare.pop_back();
+        return p;
+    }
+    patches.emplace_back();
+    patches.back().Resize(block, nghost);
+    return static_cast<int>(patches.size()) - 1;
+}
+
+void Amr::Prolong(const Grid &g, Patch &patch, const int bi, const int bj) const {
+    patch.bi = bi;
+    patch.bj = bj;
+    patch.tile.i0 = AMR_RATIO * block * bi;
+    patch.tile.j0 = AMR_RATIO * block * bj;
+    const int ng = g.nghost;
+    const Field2D *coarse[4] = {&g.cons.rho, &g.cons.u, &g.cons.v, &g.cons.en};
+    Field2D *fine[4] = {&patch.cons.rho, &patch.cons.u, &patch.cons.v, &patch.cons.en};
+    // Conserved variable k of a coarse cell, mirrored at the walls
+    const auto value = [&](const int k, const int i, int j) {
+        float sgn = 1.0f;
+        if (j < 0 || j >= g.ny) {
+            j = j < 0 ? -1 - j : 2 * g.ny - 1 - j;
+            sgn = k == 2 ? -1.0f : 1.0f;
+        }
+        return sgn * (*coarse[k])((i + g.nx) % g.nx, j);
+    };
+    for (int fj = 0; fj < patch.tile.ny; fj++) {
+        for (int fi = 0; fi < patch.tile.nx; fi++) {
+            const int i = bi * block + fi / AMR_RATIO;
+            const int j = bj * block + fj / AMR_RATIO;
+            // Linear in the conserved variables with limited slopes, so the fine cells average
+            // to the coarse one
+            for (int k = 0; k < 4; k++) {
+                const float c = value(k, i, j);
+                const float sx = minmod(c - value(k, i - 1, j), value(k, i + 1, j) - c);
+                const float sy = minmod(c - value(k, i, j - 1), value(k, i, j + 1) - c);
+                (*fine[k])(fi, fj) = c + fine_offset(fi) * sx + fine_offset(fj) * sy;
+            }
+            patch.gx(fi, fj) = g.gx(i + ng, j + ng);
+            patch.gy(fi, fj) = g.gy(i + ng, j + ng);
+        }
+    }
+    ConsToPrim(g, patch);
+}
+
+void Amr::SaveCoarse(const Grid &g) {
+    const Field2D *fields[4] = {&g.rho, &g.u, &g.v, &g.en};
+    Field2D *saved[4] = {&prim_old.rho, &prim_old.u, &prim_old.v, &prim_old.en};
+    for (int k = 0; k < 4; k++) {
+        for (int j = 0; j < g.ny; j++) {
+            std::memcpy(saved[k]->Row(j), fields[k]->Row(j + g.nghost) + g.nghost, g.nx * sizeof(float));
+        }
+    }
+}
+
+float Amr::CoarseValue(const Grid &g, const int k, int i, int j, const float theta) const {
+    float sgn = 1.0f;
+    if (j < 0 || j >= g.ny) {
+        j = j < 0 ? -1 - j : 2 * g.ny - 1 - j;
+        sgn = k == 2 ? -1.0f : 1.0f;
+    }
+    i = (i % g.nx + g.nx) % g.nx;
+    const Field2D *now[4] = {&g.rho, &g.u, &g.v, &g.en};
+    const Field2D *old[4] = {&prim_old.rho, &prim_old.u, &prim_old.v, &prim_old.en};
+    return sgn * ((1.0f - theta) * (*old[k])(i, j) + theta * (*now[k])(i + g.nghost, j + g.nghost));
+}
+
+void Amr::FillHalo(const Grid &g, Patch &patch, const float theta) const {
+    Tile &tile = patch.tile;
+    const int ng = g.nghost;
+    const int fnx = AMR_RATIO * g.nx;
+    const int fny = AMR_RATIO * g.ny;
+    const int side = AMR_RATIO * block;
+    Field2D *dst[4] = {&tile.rho, &tile.u, &tile.v, &tile.en};
+    const auto fill = [&](const int il, const int jl) {
+        // Fine cell of the halo cell, mirrored at the walls and wrapped in x
+        int fi = tile.i0 + il - ng;
+        int fj = tile.j0 + jl - ng;
+        float sgn = 1.0f;
+        if (fj < 0 || fj >= fny) {
+            fj = fj < 0 ? -1 - fj : 2 * fny - 1 - fj;
+            sgn = -1.0f;
+        }
+        fi = (fi % fnx + fnx) % fnx;
+        const int p = patch_of_block[(fj / side) * nbx + fi / side];
+        float q[4];
+        if (p >= 0) {
+            // Interior of a patch at the same stage
+            const Tile &src = patches[p].tile;
+            const Field2D *fields[4] = {&src.rho, &src.u, &src.v, &src.en};
+            for (int k = 0; k < 4; k++) {
+                q[k] = (*fields[k])(fi - src.i0 + ng, fj - src.j0 + ng);
+            }
+        } else {
+            // Linear interpolation of the coarse primitives in space and time
+            const int i = fi / AMR_RATIO;
+            const int j = fj / AMR_RATIO;
+            for (int k = 0; k < 4; k++) {
+                const float c = CoarseValue(g, k, i, j, theta);
+                const float sx = minmod(c - CoarseValue(g, k, i - 1, j, theta),
+                                        CoarseValue(g, k, i + 1, j, theta) - c);
+                const float sy = minmod(c - CoarseValue(g, k, i, j - 1, theta),
+                                        CoarseValue(g, k, i, j + 1, theta) - c);
+                q[k] = c + fine_offset(fi) * sx + fine_offset(fj) * sy;
+            }
+        }
+        q[2] *= sgn;
+        for (int k = 0; k < 4; k++) {
+            (*dst[k])(il, jl) = q[k];
+        }
+    };
+    const int width = tile.nx + 2 * ng;
+    for (int jl = 0; jl < tile.ny + 2 * ng; jl++) {
+        if (jl < ng || jl >= tile.ny + ng) {
+            for (int il = 0; il < width; il++) {
+                fill(il, jl);
+            }
+        } else {
+            for (int il = 0; il < ng; il++) {
+                fill(il, jl);
+                fill(width - 1 - il, jl);
+            }
+        }
+    }
+}
+
+void Amr::GravitySource(Patch &patch) const {
+    Tile &tile = patch.tile;
+    for (int j = 0; j < tile.ny; j++) {
+        const float *gx_row = patch.gx.Row(j);
+        const float *gy_row = patch.gy.Row(j);
+        const float *rho_row = tile.rho.Row(j + nghost) + nghost;
+        const float *u_row = tile.u.Row(j + nghost) + nghost;
+        const float *v_row = tile.v.Row(j + nghost) + nghost;
+        float *res_u = tile.res.u.Row(j);
+        float *res_v = tile.res.v.Row(j);
+        float *res_en = tile.res.en.Row(j);
+        for (int i = 0; i < tile.nx; i++) {
+            res_u[i] -= gx_row[i] * rho_row[i];
+            res_v[i] -= gy_row[i] * rho_row[i];
+            res_en[i] -= (gx_row[i] * u_row[i] + gy_row[i] * v_row[i]) * rho_row[i];
+        }
+    }
+}
+
+void Amr::ConsToPrim(const Grid &g, Patch &patch) const {
+    Tile &tile = patch.tile;
+    const float gamma_ad = g.gamma_ad;
+    for (int j = 0; j < tile.ny; j++) {
+        float *rho_row = tile.rho.Row(j + nghost) + nghost;
+        float *u_row = tile.u.Row(j + nghost) + nghost;
+        float *v_row = tile.v.Row(j + nghost) + nghost;
+        float *en_row = tile.en.Row(j + nghost) + nghost;
+        const float *crho = patch.cons.rho.Row(j);
+        const float *cu = patch.cons.u.Row(j);
+        const float *cv = patch.cons.v.Row(j);
+        const float *cen = patch.cons.en.Row(j);
+        for (int i = 0; i < tile.nx; i++) {
+            const float rho_new = crho[i] > 0.0f ? crho[i] : 1.0e-6f;
+            u_row[i] = cu[i] / rho_new;
+            v_row[i] = cv[i] / rho_new;
+            en_row[i] = (gamma_ad - 1) * (cen[i] - 0.5 / rho_new * (std::pow(cu[i], 2) + std::pow(cv[i], 2)));
+            rho_row[i] = rho_new;
+        }
+    }
+}
+
+void Amr::ClearFluxes() {
+    for (const int p: active) {
+        Patch &patch = patches[p];
+        for (Field2D *f: {&patch.flux_x.rho, &patch.flux_x.u, &patch.flux_x.v, &patch.flux_x.en,
+                          &patch.flux_y.rho, &patch.flux_y.u, &patch.flux_y.v, &patch.flux_y.en}) {
+            f->Fill(0.0f);
+        }
+    }
+}
+
+void Amr::Synchronize(Grid &g, const float dt) {
+    Field2D *cons[4] = {&g.cons.rho, &g.cons.u, &g.cons.v, &g.cons.en};
+    for (const int p: active) {
+        const Patch &patch = patches[p];
+        const Field2D *fine[4] = {&patch.cons.rho, &patch.cons.u, &patch.cons.v, &patch.cons.en};
+        const int i0 = patch.bi * block;
+        const int j0 = patch.bj * block;
+        for (int k = 0; k < 4; k++) {
+            for (int j = 0; j < block; j++) {
+                const float *f0 = fine[k]->Row(AMR_RATIO * j);
+                const float *f1 = fine[k]->Row(AMR_RATIO * j + 1);
+                float *c = cons[k]->Row(j0 + j) + i0;
+                for (int i = 0; i < block; i++) {
+                    c[i] = 0.25f * (f0[2 * i] + f0[2 * i + 1] + f1[2 * i] + f1[2 * i + 1]);
+                }
+            }
+        }
+        g.ConsToPrim(i0, i0 + block, j0, j0 + block);
+    }
+
+    // The coarse cell on the other side of a patch face was updated with the coarse flux through
+    // it, swap that for the fine flux the patch used
+    const Field2D *coarse_x[4] = {&flux_x.rho, &flux_x.u, &flux_x.v, &flux_x.en};
+    const Field2D *coarse_y[4] = {&flux_y.rho, &flux_y.u, &flux_y.v, &flux_y.en};
+    for (const int p: active) {
+        const Patch &patch = patches[p];
+        const Field2D *fine_x[4] = {&patch.flux_x.rho, &patch.flux_x.u, &patch.flux_x.v, &patch.flux_x.en};
+        const Field2D *fine_y[4] = {&patch.flux_y.rho, &patch.flux_y.u, &patch.flux_y.v, &patch.flux_y.en};
+        const int bi = patch.bi, bj = patch.bj;
+        const int i0 = bi * block;
+        const int j0 = bj * block;
+        const int left = (bi + nbx - 1) % nbx;
+        const int right = (bi + 1) % nbx;
+        if (patch_of_block[bj * nbx + left] < 0) {
+            const int i = (i0 + g.nx - 1) % g.nx;
+            for (int k = 0; k < 4; k++) {
+                for (int j = 0; j < block; j++) {
+                    (*cons[k])(i, j0 + j) += dt / g.dlx * ((*coarse_x[k])(bi, j0 + j) - (*fine_x[k])(j, 0));
+                }
+            }
+            g.ConsToPrim(i, i + 1, j0, j0 + block);
+        }
+        if (patch_of_block[bj * nbx + right] < 0) {
+            const int i = right * block;
+            for (int k = 0; k < 4; k++) {
+                for (int j = 0; j < block; j++) {
+                    (*cons[k])(i, j0 + j) += dt / g.dlx * ((*fine_x[k])(j, 1) - (*coarse_x[k])(right, j0 + j));
+                }
+            }
+            g.ConsToPrim(i, i + 1, j0, j0 + block);
+        }
+        // No cells past the walls
+        if (bj > 0 && patch_of_block[(bj - 1) * nbx + bi] < 0) {
+            const int j = j0 - 1;
+            for (int k = 0; k < 4; k++) {
+                for (int i = 0; i < block; i++) {
+                    (*cons[k])(i0 + i, j) += dt / g.dly * ((*coarse_y[k])(i0 + i, bj) - (*fine_y[k])(i, 0));
+                }
+            }
+            g.ConsToPrim(i0, i0 + block, j, j + 1);
+        }
+        if (bj + 1 < nby && patch_of_block[(bj + 1) * nbx + bi] < 0) {
+            const int j = j0 + block;
+            for (int k = 0; k < 4; k++) {
+                for (int i = 0; i < block; i++) {
+                    (*cons[k])(i0 + i, j) += dt / g.dly * ((*fine_y[k])(i, 1) - (*coarse_y[k])(i0 + i, bj + 1));
+                }
+            }
+            g.ConsToPrim(i0, i0 + block, j, j + 1);
+        }
+    }
+}
+
+void Amr::Composite(const Grid &g, Snapshot &snapshot) const {
+    const int fnx = AMR_RATIO * g.nx;
+    const int fny = AMR_RATIO * g.ny;
+    const int side = AMR_RATIO * block;
+    const Field2D *coarse[4] = {&g.rho, &g.u, &g.v, &g.en};
+    Field2D *out[4] = {&snapshot.rho, &snapshot.u, &snapshot.v, &snapshot.en};
+    for (int k = 0; k < 4; k++) {
+        if (out[k]->nx != fnx || out[k]->ny != fny) {
+            out[k]->Resize(fnx, fny);
+        }
+    }
+    for (int fj = 0; fj < fny; fj++) {
+        for (int fi = 0; fi < fnx; fi++) {
+            const int p = patch_of_block[(fj / side) * nbx + fi / side];
+            if (p >= 0) {
+                const Tile &tile = patches[p].tile;
+                const Field2D *fine[4] = {&tile.rho, &tile.u, &tile.v, &tile.en};
+                for (int k = 0; k < 4; k++) {
+                    (*out[k])(fi, fj) = (*fine[k])(fi - tile.i0 + nghost, fj - tile.j0 + nghost);
+                }
+            } else {
+                for (int k = 0; k < 4; k++) {
+                    (*out[k])(fi, fj) = (*coarse[k])(fi / AMR_RATIO + g.nghost, fj / AMR_RATIO + g.nghost);
+                }
+            }
+        }
+    }
+}
+
+long Amr::FineCells() const {
+    const long side = AMR_RATIO * block;
+    return static_cast<long>(active.size()) * side * side;
+}
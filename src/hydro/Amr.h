@@ -0,0 +1,193 @@
+#ifndef APEP_HYDRO_AMR_H
+#define APEP_HYDRO_AMR_H
+
+#include <vector>
+
+#include "Field.h"
+#include "Hydro.h"
+#include "Workspace.h"
+
+struct Grid;
+struct Snapshot;
+
+enum RefineCriterion {
+    REFINE_GRADIENT = 0, // Relative density jump between neighbouring cells above the threshold
+    REFINE_INTERFACE = 1, // Density between the two fluids, at least threshold away from either
+};
+
+// Refinement ratio between the base grid and the patches, in space and in time
+static constexpr int AMR_RATIO = 2;
+
+// Fine copy of one coarse block of block * block cells. The tile holds the fine primitives with
+// their halo and is advanced by the same sweeps as the tiles of the base grid, in fine cell
+// coordinates. Fluxes through the four sides are summed over the substeps for refluxing.
+struct Patch {
+    int bi = 0, bj = 0; // Coarse block the patch refines
+    Tile tile;
+    QVec2 cons, cons0; // Conserved state of the fine cells and its copy at the start of the substep
+    Field2D gx, gy; // Gravity of the fine cells
+    QVec2 flux_x; // Through the left (row 0) and right (row 1) side, one entry per coarse row
+    QVec2 flux_y; // Through the bottom (row 0) and top (row 1) side, one entry per coarse column
+
+    void Resize(int block, int nghost);
+};
+
+// Two level block-structured refinement of the grid. The base grid is split into square blocks,
+// and blocks flagged by the refinement criterion are covered by a patch at twice the resolution
+// that takes two substeps per coarse step. Patch halos come from neighbouring patches or are
+// interpolated from the coarse level in space and time. After the substeps the coarse cells
+// under a patch are replaced by the average of the fine ones, and the coarse cells next to a
+// patch are corrected by the difference between the coarse and fine fluxes through their
+// shared faces, so the composite grid conserves mass, momentum and energy.
+struct Amr {
+    bool enabled = false;
+    int block = 16; // Coarse cells per block side
+    int criterion = REFINE_GRADIENT;
+    float threshold = 0.05f;
+    int regrid_interval = 4; // Coarse steps between regrids
+    int nbx = 0, nby = 0; // Blocks per row and per column
+    int nghost = 0;
+    std::vector<int> patch_of_block; // Index into patches, -1 where the block is not refined
+    std::vector<Patch> patches; // Every patch allocated so far, reused by later regrids
+    std::vector<int> active; // Patches in use, in block order
+    std::vector<int> spare; // Patches not in use
+    std::vector<char> flags; // Per block, scratch of Regrid
+    QVec2 prim_old; // Coarse primitives at the start of the coarse step, rho/u/v/en in its slots
+    QVec2 flux_x; // Coarse fluxes through the left face of every block, (bi, j)
+    QVec2 flux_y; // Coarse fluxes through the bottom face of every block, (i, bj)
+
+    // Sets the block layout from the grid size. Refinement stays off unless requested and the
+    // grid splits into whole blocks on a single MPI rank.
+    void Configure(const Grid &g, bool requested, int block, int criterion, float threshold, int regrid_interval);
+
+    // Why refinement cannot run on a grid of nx * ny cells over ranks MPI ranks, or nullptr
+    // when it can. Lets callers report a request Configure had to turn down.
+    static const char *Unsupported(int ranks, int nx, int ny, int block);
+
+    // Flags blocks from the coarse state plus one block around them, then creates and drops
+    // patches to match. New patches are filled from the coarse cells by conservative linear
+    // interpolation.
+    void Regrid(Grid &g);
+
+    // Replaces the patches by new ones over the given blocks, in increasing order, filled from
+    // the coarse cells like in Regrid
+    void SetPatches(const Grid &g, const std::vector<int> &blocks);
+
+    // Keeps the coarse primitives of the start of the step for the time interpolation of halos
+    void SaveCoarse(const Grid &g);
+
+    // Zeroes the fine flux sums of the patches before the substeps of a coarse step
+    void ClearFluxes();
+
+    // Fills the halo of the patch at fraction theta of the coarse step
+    void FillHalo(const Grid &g, Patch &patch, float theta) const;
+
+    // Adds the gravity source terms of the fine cells to the patch residual
+    void GravitySource(Patch &patch) const;
+
+    // Fine primitives of the patch from its conserved state
+    void ConsToPrim(const Grid &g, Patch &patch) const;
+
+    // Replaces the coarse cells under every patch by the average of the fine cells and applies
+    // the flux correction of a coarse step of length dt to the coarse cells around the patches
+    void Synchronize(Grid &g, float dt);
+
+    // Composite of both levels at the fine resolution, coarse cells repeated where unrefined
+    void Composite(const Grid &g, Snapshot &snapshot) const;
+
+    // Number of fine cells over all patches
+    long FineCells() const;
+
+private:
+    bool NeedsRefinement(const Grid &g, int bi, int bj) const;
+
+    // Index of an unused patch, allocating one only if none is left over from earlier regrids
+    int NewPatch();
+
+    // Places the patch over block (bi, bj) and fills it from the coarse cells
+    void Prolong(const Grid &g, Patch &patch, int bi, int bj) const;
+
+    // Primitive k (rho, u, v, en) of coarse cell (i, j) at fraction theta of the coarse step,
+    // with the boundary conditions for cells outside the domain
+    float CoarseValue(const Grid &g, int k, int i, int j, float theta) const;
+};
+
+// The sweeps hand every row of interface fluxes to a recorder. These keep the fluxes on block
+// faces for the flux correction, y-fluxes are stored with the momentum components swapped back.
+struct NoFluxRecord {
+    void X(int, const QVec &) {
+    }
+
+    void Y(int, int, int, const QVec &) {
+    }
+};
+
+// Coarse fluxes of a tile, weighted by the share of the Runge-Kutta stage in the step
+struct CoarseFluxRecord {
+    Amr &amr;
+    const Tile &tile;
+    float weight;
+    bool first; // First stage of the step, overwrites the previous step
+
+    // Row j of the tile, interfaces 0..nx
+    void X(const int j, const QVec &flux) {
+        const int block = amr.block;
+        Field2D *reg[4] = {&amr.flux_x.rho, &amr.flux_x.u, &amr.flux_x.v, &amr.flux_x.en};
+        const float *f[4] = {flux.rho, flux.u, flux.v, flux.en};
+        for (int k = (block - tile.i0 % block) % block; k < tile.nx; k += block) {
+            for (int n = 0; n < 4; n++) {
+                float &r = (*reg[n])((tile.i0 + k) / block, tile.j0 + j);
+                r = (first ? 0.0f : r) + weight * f[n][k];
+            }
+        }
+    }
+
+    // Interface row jf of the tile, columns ib..ib+n
+    void Y(const int jf, const int ib, const int n, const QVec &flux) {
+        const int row = tile.j0 + jf;
+        if (jf == tile.ny || row % amr.block != 0) {
+            return;
+        }
+        Field2D *reg[4] = {&amr.flux_y.rho, &amr.flux_y.u, &amr.flux_y.v, &amr.flux_y.en};
+        const float *f[4] = {flux.rho, flux.v, flux.u, flux.en};
+        for (int m = 0; m < 4; m++) {
+            float *r = reg[m]->Row(row / amr.block) + tile.i0 + ib;
+            for (int i = 0; i < n; i++) {
+                r[i] = (first ? 0.0f : r[i]) + weight * f[m][i];
+            }
+        }
+    }
+};
+
+// Fine fluxes through the sides of a patch, averaged onto the coarse faces. The weight includes
+// the stage share, the substep length and the two fine faces per coarse face.
+struct PatchFluxRecord {
+    Patch &patch;
+    float weight;
+
+    void X(const int j, const QVec &flux) {
+        Field2D *reg[4] = {&patch.flux_x.rho, &patch.flux_x.u, &patch.flux_x.v, &patch.flux_x.en};
+        const float *f[4] = {flux.rho, flux.u, flux.v, flux.en};
+        for (int n = 0; n < 4; n++) {
+            (*reg[n])(j / AMR_RATIO, 0) += weight * f[n][0];
+            (*reg[n])(j / AMR_RATIO, 1) += weight * f[n][patch.tile.nx];
+        }
+    }
+
+    void Y(const int jf, const int ib, const int n, const QVec &flux) {
+        if (jf != 0 && jf != patch.tile.ny) {
+            return;
+        }
+        const int side = jf == 0 ? 0 : 1;
+        Field2D *reg[4] = {&patch.flux_y.rho, &patch.flux_y.u, &patch.flux_y.v, &patch.flux_y.en};
+        const float *f[4] = {flux.rho, flux.v, flux.u, flux.en};
+        for (int m = 0; m < 4; m++) {
+            float *r = reg[m]->Row(side);
+            for (int i = 0; i < n; i++) {
+                r[(ib + i) / AMR_RATIO] += weight * f[m][i];
+            }
+        }
+    }
+};
+
+#endif //APEP_HYDRO_AMR_H
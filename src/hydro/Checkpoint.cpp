@@ -0,0 +1,216 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+#include "Grid.h"
+#include "Settings.h"
+
+// Opens filename and reads its header, null with the file closed if it is not a checkpoint
+static FILE *open_checkpoint(const std::string &filename, CheckpointHeader &header) {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file %s\n", filename.c_str());
+        return nullptr;
+    }
+    const bool complete = fread(&header, sizeof(header), 1, file) == 1 && fseeko(file, 0, SEEK_END) == 0;
+    const uint64_t size = complete ? ftello(file) : 0;
+    if (!complete || std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0
+        || header.version != CHECKPOINT_VERSION || header.header_size != sizeof(CheckpointHeader)
+        || header.file_size != size || header.nx <= 0 || header.ny <= 0 || header.npatches < 0) {
+        fprintf(stderr, "Not a version %u checkpoint file: %s\n", CHECKPOINT_VERSION, filename.c_str());
+        fclose(file);
+        return nullptr;
+    }
+    return file;
+}
+
+bool ReadCheckpointSettings(const std::string &filename, RTSettings &settings) {
+    CheckpointHeader header;
+    FILE *file = open_checkpoint(filename, header);
+    if (file == nullptr) {
+        return false;
+    }
+    fclose(file);
+    settings.nx = header.nx;
+    settings.ny = header.ny;
+    settings.nghost = header.nghost;
+    settings.rho_ini_upper = header.rho_ini_upper;
+    settings.rho_ini_lower = header.rho_ini_lower;
+    settings.en_ini = header.en_ini;
+    settings.grav_x_ini = header.grav_x_ini;
+    settings.grav_y_ini = header.grav_y_ini;
+    settings.x1 = header.x1;
+    settings.x2 = header.x2;
+    settings.y1 = header.y1;
+    settings.y2 = header.y2;
+    settings.perturb_strength = header.perturb_strength;
+    settings.cfl = header.cfl;
+    settings.gamma_ad = header.gamma_ad;
+    settings.reconstruct_type = header.reconstruct_type;
+    settings.limiter_type = header.limiter_type;
+    settings.riemann_solver_type = header.riemann_solver_type;
+    settings.rkstages = header.rkstages;
+    settings.dt_type = header.dt_type;
+    settings.dt_growth = header.dt_growth;
+    settings.tile_nx = header.tile_nx;
+    settings.tile_ny = header.tile_ny;
+    settings.amr = header.amr;
+    settings.amr_block = header.amr_block;
+    settings.amr_criterion = header.amr_criterion;
+    settings.amr_threshold = header.amr_threshold;
+    settings.amr_regrid = header.amr_regrid;
+    return true;
+}
+
+bool Grid::WriteCheckpoint(const std::string &filename) {
+    // Every rank sends its rows, rank 0 writes the whole grid
+    Field2D global[4];
+    Field2D *const fields[4] = {&rho, &u, &v, &en};
+    for (int k = 0; k < 4; k++) {
+        domain.Gather(*fields[k], nx, nghost, global[k]);
+    }
+    if (domain.rank != 0) {
+        return domain.GlobalMin(1.0f) > 0.0f;
+    }
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = sizeof(CheckpointHeader);
+    header.nx = nx;
+    header.ny = domain.ny_global;
+    header.nghost = nghost;
+    header.rho_ini_upper = rho_ini_upper;
+    header.rho_ini_lower = rho_ini_lower;
+    header.en_ini = en_ini;
+    header.grav_x_ini = grav_x_ini;
+    header.grav_y_ini = grav_y_ini;
+    header.x1 = x1;
+    header.x2 = x2;
+    header.y1 = y1;
+    header.y2 = y2;
+    header.perturb_strength = perturb_strength;
+    header.cfl = cfl;
+    header.gamma_ad = gamma_ad;
+    header.reconstruct_type = reconstruct_type;
+    header.limiter_type = limiter_type;
+    header.riemann_solver_type = riemann_solver_type;
+    header.rkstages = rkstages;
+    header.dt_type = dt_type;
+    header.dt_growth = dt_growth;
+    header.tile_nx = tile_nx;
+    header.tile_ny = tile_ny;
+    header.amr = amr.enabled;
+    header.amr_block = amr.block;
+    header.amr_criterion = amr.criterion;
+    header.amr_threshold = amr.threshold;
+    header.amr_regrid = amr.regrid_interval;
+    header.step = step;
+    header.time = time;
+    header.dt = dt;
+    header.npatches = static_cast<int32_t>(amr.active.size());
+    header.patch_side = AMR_RATIO * amr.block;
+    const uint64_t side = header.patch_side;
+    header.grid_offset = sizeof(CheckpointHeader);
+    header.blocks_offset = header.grid_offset + 4 * static_cast<uint64_t>(nx) * header.ny * sizeof(float);
+    header.patches_offset = header.blocks_offset + header.npatches * sizeof(int32_t);
+    header.file_size = header.patches_offset + header.npatches * 4 * side * side * sizeof(float);
+
+    const std::string partial = filename + ".tmp";
+    FILE *file = fopen(partial.c_str(), "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file %s\n", partial.c_str());
+        return domain.GlobalMin(0.0f) > 0.0f;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int k = 0; ok && k < 4; k++) {
+        for (int j = 0; ok && j < header.ny; j++) {
+            ok = fwrite(global[k].Row(j), sizeof(float), nx, file) == static_cast<size_t>(nx);
+        }
+    }
+    for (const int p: amr.active) {
+        const int32_t b = amr.patches[p].bj * amr.nbx + amr.patches[p].bi;
+        ok = ok && fwrite(&b, sizeof(b), 1, file) == 1;
+    }
+    for (const int p: amr.active) {
+        const QVec2 &cons = amr.patches[p].cons;
+        for (const Field2D *f: {&cons.rho, &cons.u, &cons.v, &cons.en}) {
+            for (uint64_t j = 0; ok && j < side; j++) {
+                ok = fwrite(f->Row(j), sizeof(float), side, file) == side;
+            }
+        }
+    }
+    // The data must be on disk before the rename makes the file visible under its name
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || std::rename(partial.c_str(), filename.c_str()) != 0) {
+        fprintf(stderr, "Error writing file %s\n", filename.c_str());
+        std::remove(partial.c_str());
+        ok = false;
+    }
+    return domain.GlobalMin(ok ? 1.0f : 0.0f) > 0.0f;
+}
+
+bool Grid::ReadCheckpoint(const std::string &filename) {
+    CheckpointHeader header;
+    FILE *file = open_checkpoint(filename, header);
+    bool ok = file != nullptr;
+    if (ok && (header.nx != nx || header.ny != domain.ny_global || (header.amr != 0) != amr.enabled
+               || (amr.enabled && header.patch_side != AMR_RATIO * amr.block))) {
+        fprintf(stderr, "Checkpoint %s does not match the grid, refined runs restart on a single rank\n",
+                filename.c_str());
+        fclose(file);
+        file = nullptr;
+        ok = false;
+    }
+    // This rank's rows of every field
+    Field2D *const fields[4] = {&rho, &u, &v, &en};
+    for (int k = 0; ok && k < 4; k++) {
+        const uint64_t offset =
+            header.grid_offset + (static_cast<uint64_t>(k) * header.ny + domain.j_offset) * nx * sizeof(float);
+        ok = fseeko(file, offset, SEEK_SET) == 0;
+        for (int j = 0; ok && j < ny; j++) {
+            ok = fread(fields[k]->Row(j + nghost) + nghost, sizeof(float), nx, file) == static_cast<size_t>(nx);
+        }
+    }
+    if (ok) {
+        time = header.time;
+        dt = header.dt;
+        step = header.step;
+        PrimToCons();
+    }
+
+    if (ok && amr.enabled) {
+        std::vector<int> blocks(header.npatches);
+        ok = fseeko(file, header.blocks_offset, SEEK_SET) == 0;
+        for (int n = 0; ok && n < header.npatches; n++) {
+            int32_t b;
+            ok = fread(&b, sizeof(b), 1, file) == 1 && b >= 0 && b < amr.nbx * amr.nby && (n == 0 || b > blocks[n - 1]);
+            blocks[n] = b;
+        }
+        if (ok) {
+            amr.SetPatches(*this, blocks);
+        }
+        const size_t side = header.patch_side;
+        for (int n = 0; ok && n < header.npatches; n++) {
+            Patch &patch = amr.patches[amr.active[n]];
+            for (Field2D *f: {&patch.cons.rho, &patch.cons.u, &patch.cons.v, &patch.cons.en}) {
+                for (size_t j = 0; ok && j < side; j++) {
+                    ok = fread(f->Row(j), sizeof(float), side, file) == side;
+                }
+            }
+            amr.ConsToPrim(*this, patch);
+        }
+    }
+    if (file != nullptr) {
+        if (!ok) {
+            fprintf(stderr, "Error reading file %s\n", filename.c_str());
+        }
+        fclose(file);
+    }
+    return domain.GlobalMin(ok ? 1.0f : 0.0f) > 0.0f;
+}
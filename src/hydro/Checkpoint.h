@@ -0,0 +1,53 @@
+#ifndef APEP_HYDRO_CHECKPOINT_H
+#define APEP_HYDRO_CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+
+// Checkpoint files hold everything a run needs to continue bit for bit: the settings that shape
+// the solver, time, dt and step, the interior primitives of the base grid and the conserved
+// state of every refined patch. The layout is a CheckpointHeader followed by
+// - rho, u, v, en of the base grid, ny rows of nx floats each,
+// - the block index of every patch, npatches int32,
+// - rho, u, v, en of the conserved state of every patch, side rows of side floats each.
+// Values are little-endian like snapshot files. Checkpoints are written to a temporary file
+// that is synced and renamed, so a file with the final name is always complete.
+
+static constexpr char CHECKPOINT_MAGIC[8] = {'A', 'P', 'E', 'P', 'C', 'K', 'P', 'T'};
+static constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size; // sizeof(CheckpointHeader) of the writer
+    // Settings
+    int32_t nx, ny, nghost;
+    float rho_ini_upper, rho_ini_lower;
+    float en_ini;
+    float grav_x_ini, grav_y_ini;
+    float x1, x2, y1, y2;
+    float perturb_strength;
+    float cfl, gamma_ad;
+    int32_t reconstruct_type, limiter_type, riemann_solver_type, rkstages;
+    int32_t dt_type;
+    float dt_growth;
+    int32_t tile_nx, tile_ny;
+    int32_t amr, amr_block, amr_criterion;
+    float amr_threshold;
+    int32_t amr_regrid;
+    // State
+    int64_t step;
+    float time, dt;
+    // Layout
+    int32_t npatches;
+    int32_t patch_side; // Fine cells per patch side
+    uint64_t grid_offset, blocks_offset, patches_offset; // Bytes from the start of the file
+    uint64_t file_size;
+};
+
+// Reads the settings of a checkpoint into settings, leaving the values that do not change the
+// results (tmax, threads and the UI flags) alone. Returns false and reports on stderr when the
+// file is not a checkpoint of this version.
+bool ReadCheckpointSettings(const std::string &filename, struct RTSettings &settings);
+
+#endif //APEP_HYDRO_CHECKPOINT_H
@@ -0,0 +1,198 @@
+#include "Colormap.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "Simd.h"
+
+// Packed like IM_RGB in implot.cpp
+static constexpr uint32_t rgb(const uint32_t r, const uint32_t g, const uint32_t b) {
+    return r | g << 8 | b << 16 | 0xFF000000u;
+}
+
+struct ColormapKeys {
+    const char *name;
+    bool qualitative;
+    std::vector<uint32_t> keys;
+};
+
+// Key colors from ImPlot's Initialize
+static const ColormapKeys COLORMAPS[COLORMAP_COUNT] = {
+    {"Deep", true, {4289753676, 4283598045, 4285048917, 4283584196, 4289950337, 4284512403, 4291005402, 4287401100,
+                    4285839820, 4291671396}},
+    {"Dark", true, {4280031972, 4290281015, 4283084621, 4288892568, 4278222847, 4281597951, 4280833702, 4290740727,
+                    4288256409}},
+    {"Pastel", true, {4289639675, 4293119411, 4291161036, 4293184478, 4289124862, 4291624959, 4290631909, 4293712637,
+                      4294111986}},
+    {"Paired", true, {4293119554, 4290017311, 4287291314, 4281114675, 4288256763, 4280031971, 4285513725, 4278222847,
+                      4292260554, 4288298346, 4288282623, 4280834481}},
+    {"Viridis", false, {4283695428, 4285867080, 4287054913, 4287455029, 4287526954, 4287402273, 4286883874, 4285579076,
+                        4283552122, 4280737725, 4280674301}},
+    {"Plasma", false, {4287039501, 4288480321, 4289200234, 4288941455, 4287638193, 4286072780, 4284638433, 4283139314,
+                       4281771772, 4280667900, 4280416752}},
+    {"Hot", false, {4278190144, 4278190208, 4278190271, 4278190335, 4278206719, 4278223103, 4278239231, 4278255615,
+                    4283826175, 4289396735, 4294967295}},
+    {"Cool", false, {4294967040, 4294960666, 4294954035, 4294947661, 4294941030, 4294934656, 4294928025, 4294921651,
+                     4294915020, 4294908646, 4294902015}},
+    {"Pink", false, {4278190154, 4282532475, 4284308894, 4285690554, 4286879686, 4287870160, 4288794330, 4289651940,
+                     4291685869, 4293392118, 4294967295}},
+    {"Jet", false, {4289331200, 4294901760, 4294923520, 4294945280, 4294967040, 4289396565, 4283826090, 4278255615,
+                    4278233855, 4278212095, 4278190335}},
+    {"Twilight", false, {rgb(226, 217, 226), rgb(166, 191, 202), rgb(109, 144, 192), rgb(95, 88, 176), rgb(83, 30, 124),
+                         rgb(47, 20, 54), rgb(100, 25, 75), rgb(159, 60, 80), rgb(192, 117, 94), rgb(208, 179, 158),
+                         rgb(226, 217, 226)}},
+    {"RdBu", false, {rgb(103, 0, 31), rgb(178, 24, 43), rgb(214, 96, 77), rgb(244, 165, 130), rgb(253, 219, 199),
+                     rgb(247, 247, 247), rgb(209, 229, 240), rgb(146, 197, 222), rgb(67, 147, 195), rgb(33, 102, 172),
+                     rgb(5, 48, 97)}},
+    {"BrBG", false, {rgb(84, 48, 5), rgb(140, 81, 10), rgb(191, 129, 45), rgb(223, 194, 125), rgb(246, 232, 195),
+                     rgb(245, 245, 245), rgb(199, 234, 229), rgb(128, 205, 193), rgb(53, 151, 143), rgb(1, 102, 94),
+                     rgb(0, 60, 48)}},
+    {"PiYG", false, {rgb(142, 1, 82), rgb(197, 27, 125), rgb(222, 119, 174), rgb(241, 182, 218), rgb(253, 224, 239),
+                     rgb(247, 247, 247), rgb(230, 245, 208), rgb(184, 225, 134), rgb(127, 188, 65), rgb(77, 146, 33),
+                     rgb(39, 100, 25)}},
+    {"Spectral", false, {rgb(158, 1, 66), rgb(213, 62, 79), rgb(244, 109, 67), rgb(253, 174, 97), rgb(254, 224, 139),
+                         rgb(255, 255, 191), rgb(230, 245, 152), rgb(171, 221, 164), rgb(102, 194, 165),
+                         rgb(50, 136, 189), rgb(94, 79, 162)}},
+    {"Greys", false, {rgb(255, 255, 255), rgb(0, 0, 0)}},
+};
+
+// Blend of two packed colors with weight s / 256 on b, ImMixU32 of ImPlot
+static uint32_t mix(const uint32_t a, const uint32_t b, const uint32_t s) {
+    const uint32_t af = 256 - s;
+    const uint32_t bf = s;
+    const uint32_t al = a & 0x00ff00ff;
+    const uint32_t ah = (a & 0xff00ff00) >> 8;
+    const uint32_t bl = b & 0x00ff00ff;
+    const uint32_t bh = (b & 0xff00ff00) >> 8;
+    const uint32_t ml = al * af + bl * bf;
+    const uint32_t mh = ah * af + bh * bf;
+    return (mh & 0xff00ff00) | ((ml & 0xff00ff00) >> 8);
+}
+
+const char *ColormapName(const int cmap) {
+    return cmap >= 0 && cmap < COLORMAP_COUNT ? COLORMAPS[cmap].name : nullptr;
+}
+
+int ColormapIndex(const std::string &name) {
+    for (int cmap = 0; cmap < COLORMAP_COUNT; cmap++) {
+        const std::string candidate = COLORMAPS[cmap].name;
+        if (std::equal(candidate.begin(), candidate.end(), name.begin(), name.end(),
+                       [](const char a, const char b) { return std::tolower(a) == std::tolower(b); })) {
+            return cmap;
+        }
+    }
+    return -1;
+}
+
+ColormapLut::ColormapLut(const int cmap) {
+    const ColormapKeys &map = COLORMAPS[std::clamp(cmap, 0, COLORMAP_COUNT - 1)];
+    qualitative = map.qualitative;
+    if (qualitative) {
+        table = map.keys;
+        return;
+    }
+    for (size_t k = 0; k + 1 < map.keys.size(); k++) {
+        for (uint32_t s = 0; s < 255; s++) {
+            table.push_back(mix(map.keys[k], map.keys[k + 1], s));
+        }
+    }
+    table.push_back(map.keys.back());
+}
+
+uint32_t ColormapLut::Sample(const float t) const {
+    const int size = static_cast<int>(table.size());
+    const int k = qualitative ? std::clamp(static_cast<int>(size * t), 0, size - 1)
+                              : static_cast<int>((size - 1) * t + 0.5f);
+    return table[std::clamp(k, 0, size - 1)];
+}
+
+// Table index of every value, with the rounding of ColormapLut::Sample
+template<typename T>
+static void colormap_index(const float *values, int32_t *index, const float scale_min, const float inv_range,
+                           const float a, const float b, const float top) {
+    using L = Lanes<T>;
+    const T t = simd_min(simd_max((L::Load(values) - L::Set1(scale_min)) * L::Set1(inv_range), L::Set1(0.0f)),
+                         L::Set1(1.0f));
+    simd_store_int(index, simd_min(t * L::Set1(a) + L::Set1(b), L::Set1(top)));
+}
+
+void Colorize(const float *values, const int n, const ColormapLut &lut, const float scale_min, const float scale_max,
+              uint8_t *rgb) {
+    constexpr int CHUNK = 256;
+    const int size = static_cast<int>(lut.table.size());
+    const float inv_range = scale_max != scale_min ? 1.0f / (scale_max - scale_min) : 0.0f;
+    const float a = lut.qualitative ? size : size - 1;
+    const float b = lut.qualitative ? 0.0f : 0.5f;
+    const float top = size - 1;
+    int32_t index[CHUNK];
+    for (int c = 0; c < n; c += CHUNK) {
+        const int m = std::min(CHUNK, n - c);
+        int k = 0;
+        for (; k + SIMD_WIDTH <= m; k += SIMD_WIDTH) {
+            colormap_index<VFloat>(values + c + k, index + k, scale_min, inv_range, a, b, top);
+        }
+        for (; k < m; k++) {
+            colormap_index<float>(values + c + k, index + k, scale_min, inv_range, a, b, top);
+        }
+        uint8_t *out = rgb + 3 * static_cast<size_t>(c);
+        for (k = 0; k < m; k++) {
+            // NaN values come out as a negative index
+            const uint32_t color = lut.table[std::clamp(index[k], 0, size - 1)];
+            out[3 * k] = color & 0xff;
+            out[3 * k + 1] = (color >> 8) & 0xff;
+            out[3 * k + 2] = (color >> 16) & 0xff;
+        }
+    }
+}
+
+void FrameRenderer::Render(const Field2D &field, const int nx, const int ny, const int width, const int height,
+                           const ColormapLut &lut, const float scale_min, const float scale_max, const int resample) {
+    this->width = width > 0 ? width : nx;
+    this->height = height > 0 ? height : ny;
+    rgb.resize(static_cast<size_t>(this->width) * this->height * 3);
+    row.resize(this->width);
+    i0.resize(this->width);
+    i1.resize(this->width);
+    wx.resize(this->width);
+    const bool bilinear = resample == RESAMPLE_BILINEAR;
+
+    // Source columns are the same for every row. Image pixel centres map onto cell centres.
+    for (int c = 0; c < this->width; c++) {
+        const float x = (c + 0.5f) * nx / this->width;
+        if (bilinear) {
+            const float xc = std::clamp(x - 0.5f, 0.0f, static_cast<float>(nx - 1));
+            i0[c] = static_cast<int>(xc);
+            i1[c] = std::min(i0[c] + 1, nx - 1);
+            wx[c] = xc - i0[c];
+        } else {
+            i0[c] = std::min(static_cast<int>(x), nx - 1);
+        }
+    }
+    for (int r = 0; r < this->height; r++) {
+        // Image rows run from the top, field rows from the bottom
+        const float y = (this->height - r - 0.5f) * ny / this->height;
+        const float *values = row.data();
+        if (bilinear) {
+            const float yc = std::clamp(y - 0.5f, 0.0f, static_cast<float>(ny - 1));
+            const int j0 = static_cast<int>(yc);
+            const float wy = yc - j0;
+            const float *r0 = field.Row(j0);
+            const float *r1 = field.Row(std::min(j0 + 1, ny - 1));
+            for (int c = 0; c < this->width; c++) {
+                const float lower = r0[i0[c]] + wx[c] * (r0[i1[c]] - r0[i0[c]]);
+                const float upper = r1[i0[c]] + wx[c] * (r1[i1[c]] - r1[i0[c]]);
+                row[c] = lower + wy * (upper - lower);
+            }
+        } else {
+            const float *src = field.Row(std::min(static_cast<int>(y), ny - 1));
+            if (this->width == nx) {
+                values = src;
+            } else {
+                for (int c = 0; c < this->width; c++) {
+                    row[c] = src[i0[c]];
+                }
+            }
+        }
+        Colorize(values, this->width, lut, scale_min, scale_max, rgb.data() + static_cast<size_t>(r) * this->width * 3);
+    }
+}
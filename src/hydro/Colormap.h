@@ -0,0 +1,79 @@
+#ifndef APEP_HYDRO_COLORMAP_H
+#define APEP_HYDRO_COLORMAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Field.h"
+
+// The colormaps of ImPlot, in the order of ImPlotColormap so an index means the same map in
+// the UI and in headless frames. The hydro library does not link ImGui, so the key colors are
+// copied here.
+enum ColormapType {
+    COLORMAP_DEEP = 0,
+    COLORMAP_DARK = 1,
+    COLORMAP_PASTEL = 2,
+    COLORMAP_PAIRED = 3,
+    COLORMAP_VIRIDIS = 4,
+    COLORMAP_PLASMA = 5,
+    COLORMAP_HOT = 6,
+    COLORMAP_COOL = 7,
+    COLORMAP_PINK = 8,
+    COLORMAP_JET = 9,
+    COLORMAP_TWILIGHT = 10,
+    COLORMAP_RDBU = 11,
+    COLORMAP_BRBG = 12,
+    COLORMAP_PIYG = 13,
+    COLORMAP_SPECTRAL = 14,
+    COLORMAP_GREYS = 15,
+};
+
+static constexpr int COLORMAP_COUNT = 16;
+
+const char *ColormapName(int cmap);
+
+// Colormap with the given name, ignoring case, or -1
+int ColormapIndex(const std::string &name);
+
+// Lookup table of a colormap, built the way ImPlot builds the one PlotHeatmap samples: 255
+// steps between neighbouring key colors, or just the keys for the qualitative maps. Entries are
+// packed like ImU32, red in the low byte.
+struct ColormapLut {
+    std::vector<uint32_t> table;
+    bool qualitative = false;
+
+    ColormapLut() = default;
+
+    explicit ColormapLut(int cmap);
+
+    // Same entry ImPlot picks for t in [0, 1]
+    uint32_t Sample(float t) const;
+};
+
+// Maps n values to RGB bytes, values outside [scale_min, scale_max] get the end colors.
+// Vectorized over the values, only the table lookup is scalar.
+void Colorize(const float *values, int n, const ColormapLut &lut, float scale_min, float scale_max, uint8_t *rgb);
+
+enum ResampleType {
+    RESAMPLE_NEAREST = 0,
+    RESAMPLE_BILINEAR = 1,
+};
+
+// Renders fields to RGB frames of a given size, top row first. Buffers are kept between frames,
+// so rendering a series of frames of one size allocates only once.
+struct FrameRenderer {
+    int width = 0, height = 0;
+    std::vector<uint8_t> rgb; // width * height * 3 bytes
+
+    // Renders the interior of field, nx * ny cells with row 0 at the bottom
+    void Render(const Field2D &field, int nx, int ny, int width, int height, const ColormapLut &lut,
+                float scale_min, float scale_max, int resample);
+
+private:
+    std::vector<float> row; // Resampled values of one image row
+    std::vector<int> i0, i1; // Source columns of every image column
+    std::vector<float> wx; // Weight of column i1
+};
+
+#endif //APEP_HYDRO_COLORMAP_H
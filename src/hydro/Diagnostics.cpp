@@ -0,0 +1,147 @@
+#include "Diagnostics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Grid.h"
+
+static_assert(sizeof(Diagnostics) == 8 * 17, "diagnostics records are packed");
+
+// Sums and extremes of the cells of one tile, the sums still without the cell area
+static Diagnostics reduce_tile(const Grid &g, const Tile &tile) {
+    Diagnostics d;
+    d.bubble = -std::numeric_limits<double>::infinity(); // Tip positions for now
+    d.spike = std::numeric_limits<double>::infinity();
+    const int ng = g.nghost;
+    const double gamma_ad = g.gamma_ad;
+    const float rho_lower = g.rho_ini_lower;
+    const float rho_upper = g.rho_ini_upper;
+    double max_mach2 = 0.0;
+    for (int j = tile.j0; j < tile.j0 + tile.ny; j++) {
+        const float *rho = g.rho.Row(j + ng) + ng;
+        const float *u = g.u.Row(j + ng) + ng;
+        const float *v = g.v.Row(j + ng) + ng;
+        const float *en = g.en.Row(j + ng) + ng;
+        const float *gx = g.gx.Row(j + ng) + ng;
+        const float *gy = g.gy.Row(j + ng) + ng;
+        const double y = g.y1 + g.dly * (j + g.domain.j_offset + 0.5);
+        bool lower = false, upper = false;
+        for (int i = tile.i0; i < tile.i0 + tile.nx; i++) {
+            const double x = g.x1 + g.dlx * (i + 0.5);
+            const double speed2 = static_cast<double>(u[i]) * u[i] + static_cast<double>(v[i]) * v[i];
+            const double kinetic = 0.5 * rho[i] * speed2;
+            d.mass += rho[i];
+            d.momentum_x += static_cast<double>(rho[i]) * u[i];
+            d.momentum_y += static_cast<double>(rho[i]) * v[i];
+            d.energy += en[i] / (gamma_ad - 1.0) + kinetic;
+            d.kinetic += kinetic;
+            d.potential -= rho[i] * (gx[i] * x + gy[i] * y);
+            max_mach2 = std::max(max_mach2, speed2 * rho[i] / (gamma_ad * en[i]));
+            const bool closer_to_lower = std::abs(rho[i] - rho_lower) < std::abs(rho[i] - rho_upper);
+            lower |= closer_to_lower;
+            upper |= !closer_to_lower;
+        }
+        if (lower) {
+            d.bubble = std::max(d.bubble, y + 0.5 * g.dly);
+        }
+        if (upper) {
+            d.spike = std::min(d.spike, y - 0.5 * g.dly);
+        }
+    }
+    d.max_mach = std::sqrt(max_mach2);
+    return d;
+}
+
+Diagnostics DiagnosticsReducer::Reduce(Grid &g) {
+    const std::vector<Tile> &tiles = g.workspace.tiles;
+    const int ntiles = static_cast<int>(tiles.size());
+    partials.resize(ntiles);
+    g.pool->ParallelFor(0, ntiles, 1, [&](const int t0, const int t1, int) {
+        for (int t = t0; t < t1; t++) {
+            partials[t] = reduce_tile(g, tiles[t]);
+        }
+    });
+
+    Diagnostics d;
+    d.step = g.step;
+    d.time = g.time;
+    d.dt = g.dt;
+    double bubble_tip = g.y1, spike_tip = g.y2; // Where the tips are when a fluid is gone
+    for (const Diagnostics &p: partials) {
+        d.mass += p.mass;
+        d.momentum_x += p.momentum_x;
+        d.momentum_y += p.momentum_y;
+        d.energy += p.energy;
+        d.kinetic += p.kinetic;
+        d.potential += p.potential;
+        bubble_tip = std::max(bubble_tip, p.bubble);
+        spike_tip = std::min(spike_tip, p.spike);
+        d.max_mach = std::max(d.max_mach, p.max_mach);
+    }
+    const double area = static_cast<double>(g.dlx) * g.dly;
+    double *sums[6] = {&d.mass, &d.momentum_x, &d.momentum_y, &d.energy, &d.kinetic, &d.potential};
+    for (double *sum: sums) {
+        *sum = g.domain.GlobalSum(*sum * area);
+    }
+    bubble_tip = -g.domain.GlobalMin(static_cast<float>(-bubble_tip));
+    spike_tip = g.domain.GlobalMin(static_cast<float>(spike_tip));
+    d.max_mach = -g.domain.GlobalMin(static_cast<float>(-d.max_mach));
+    d.bubble = bubble_tip;
+    d.spike = -spike_tip;
+    d.mix_width = bubble_tip - spike_tip;
+    return d;
+}
+
+DiagnosticsFile::~DiagnosticsFile() {
+    Close();
+}
+
+bool DiagnosticsFile::Open(const std::string &filename, const bool binary, const bool append) {
+    Close();
+    this->binary = binary;
+    file = fopen(filename.c_str(), append ? "ab" : "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file %s\n", filename.c_str());
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) > 0) {
+        return true;
+    }
+    if (binary) {
+        const uint32_t version = DIAGNOSTICS_VERSION;
+        const uint32_t record_size = sizeof(Diagnostics);
+        fwrite(DIAGNOSTICS_MAGIC, sizeof(DIAGNOSTICS_MAGIC), 1, file);
+        fwrite(&version, sizeof(version), 1, file);
+        fwrite(&record_size, sizeof(record_size), 1, file);
+    } else {
+        fprintf(file, "step,time,dt,mass,momentum_x,momentum_y,energy,kinetic,potential,bubble,spike,mix_width,"
+                      "max_mach,wall_seconds,zone_cycles_per_second,write_queue_depth,write_latency\n");
+    }
+    return true;
+}
+
+bool DiagnosticsFile::Write(const Diagnostics &d) {
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok;
+    if (binary) {
+        ok = fwrite(&d, sizeof(d), 1, file) == 1;
+    } else {
+        // Enough digits to see the conservation error of the totals
+        ok = fprintf(file, "%lld,%.9g,%.9g,%.15g,%.15g,%.15g,%.15g,%.15g,%.15g,%.9g,%.9g,%.9g,%.9g,%.6g,%.6g,%g,%.6g\n",
+                     static_cast<long long>(d.step), d.time, d.dt, d.mass, d.momentum_x, d.momentum_y, d.energy,
+                     d.kinetic, d.potential, d.bubble, d.spike, d.mix_width, d.max_mach, d.wall_seconds,
+                     d.zone_cycles_per_second, d.write_queue_depth, d.write_latency) > 0;
+    }
+    return fflush(file) == 0 && ok;
+}
+
+void DiagnosticsFile::Close() {
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+}
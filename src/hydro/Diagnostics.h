@@ -0,0 +1,73 @@
+#ifndef APEP_HYDRO_DIAGNOSTICS_H
+#define APEP_HYDRO_DIAGNOSTICS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct Grid;
+
+// Scalars of one grid state for watching a run without dumping its fields. Totals are summed in
+// double over the interior cells of the base grid and are per unit depth. The mixing layer is
+// measured from the initial interface at y = 0: a cell belongs to the fluid its density is
+// closer to, the bubble tip is the highest edge of a lower fluid cell and the spike tip the
+// lowest edge of an upper fluid cell.
+struct Diagnostics {
+    int64_t step = 0;
+    double time = 0.0, dt = 0.0;
+    double mass = 0.0;
+    double momentum_x = 0.0, momentum_y = 0.0;
+    double energy = 0.0; // Total energy, internal plus kinetic
+    double kinetic = 0.0;
+    double potential = 0.0; // In the gravity field, energy + potential is conserved
+    double bubble = 0.0, spike = 0.0; // Distance of the bubble and spike tips from y = 0
+    double mix_width = 0.0; // bubble + spike
+    double max_mach = 0.0;
+    // Run performance, filled in by the driver
+    double wall_seconds = 0.0;
+    double zone_cycles_per_second = 0.0;
+    double write_queue_depth = 0.0;
+    double write_latency = 0.0;
+};
+
+// Computes Diagnostics inside the step loop with the thread pool of the grid. Every tile is
+// reduced on its own and the tiles are combined in order, so the values do not depend on the
+// number of threads.
+struct DiagnosticsReducer {
+    // Collective over the MPI ranks, every rank gets the global values
+    Diagnostics Reduce(Grid &g);
+
+private:
+    std::vector<Diagnostics> partials; // One per tile
+};
+
+static constexpr char DIAGNOSTICS_MAGIC[8] = {'A', 'P', 'E', 'P', 'D', 'I', 'A', 'G'};
+static constexpr uint32_t DIAGNOSTICS_VERSION = 1;
+
+// Time series of Diagnostics, as CSV with a header line or as binary. Binary files start with
+// DIAGNOSTICS_MAGIC, the version and the record size as uint32, then hold one little-endian
+// Diagnostics record per row. Rows are flushed as they are written, so the file can be followed
+// while the run goes on.
+struct DiagnosticsFile {
+    DiagnosticsFile() = default;
+
+    DiagnosticsFile(const DiagnosticsFile &) = delete;
+
+    DiagnosticsFile &operator=(const DiagnosticsFile &) = delete;
+
+    ~DiagnosticsFile();
+
+    // Appending to a non-empty file continues its rows without a new header
+    bool Open(const std::string &filename, bool binary, bool append);
+
+    bool Write(const Diagnostics &d);
+
+    void Close();
+
+private:
+    FILE *file = nullptr;
+    bool binary = false;
+};
+
+#endif //APEP_HYDRO_DIAGNOSTICS_H
@@ -0,0 +1,154 @@
+#include "Domain.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+void DomainInit(int *argc, char ***argv) {
+#ifdef APEP_USE_MPI
+    // Only the thread that steps the grid talks to MPI, the pool workers never do
+    int provided;
+    MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+#else
+    (void) argc;
+    (void) argv;
+#endif
+}
+
+void DomainFinalize() {
+#ifdef APEP_USE_MPI
+    MPI_Finalize();
+#endif
+}
+
+int DomainRank() {
+    int rank = 0;
+#ifdef APEP_USE_MPI
+    int initialized;
+    MPI_Initialized(&initialized);
+    if (initialized) {
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    }
+#endif
+    return rank;
+}
+
+bool Domain::Decompose(const int ny_global, const int nghost) {
+    rank = 0;
+    size = 1;
+#ifdef APEP_USE_MPI
+    int initialized;
+    MPI_Initialized(&initialized);
+    if (initialized) {
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+    }
+#endif
+    this->ny_global = ny_global;
+    j_offset = static_cast<int>(static_cast<long>(ny_global) * rank / size);
+    ny = static_cast<int>(static_cast<long>(ny_global) * (rank + 1) / size) - j_offset;
+    lower = rank > 0 ? rank - 1 : -1;
+    upper = rank < size - 1 ? rank + 1 : -1;
+    // The first rank has the fewest rows
+    const int min_rows = ny_global / size;
+    if (size > 1 && min_rows < nghost) {
+        fprintf(stderr, "Error on rank %d: %d rows over %d ranks leave slabs of %d rows, the halo exchange "
+                        "needs at least %d. Use at most %d ranks or more rows.\n", rank, ny_global, size, min_rows,
+                nghost, std::max(1, ny_global / nghost));
+        return false;
+    }
+    return true;
+}
+
+void Domain::StartHaloExchange(Field2D *const (&fields)[4], const int nghost) {
+#ifdef APEP_USE_MPI
+    nrequests = 0;
+    for (int k = 0; k < 4; k++) {
+        Field2D &f = *fields[k];
+        // Consecutive rows are contiguous, so nghost rows go out as one message
+        const int count = nghost * f.stride;
+        // Tag 2k carries rows going up, 2k + 1 rows going down
+        if (lower >= 0) {
+            MPI_Irecv(f.Row(0), count, MPI_FLOAT, lower, 2 * k, MPI_COMM_WORLD, &requests[nrequests++]);
+            MPI_Isend(f.Row(nghost), count, MPI_FLOAT, lower, 2 * k + 1, MPI_COMM_WORLD, &requests[nrequests++]);
+        }
+        if (upper >= 0) {
+            MPI_Irecv(f.Row(ny + nghost), count, MPI_FLOAT, upper, 2 * k + 1, MPI_COMM_WORLD,
+                      &requests[nrequests++]);
+            MPI_Isend(f.Row(ny), count, MPI_FLOAT, upper, 2 * k, MPI_COMM_WORLD, &requests[nrequests++]);
+        }
+    }
+#else
+    (void) fields;
+    (void) nghost;
+#endif
+}
+
+void Domain::FinishHaloExchange() {
+#ifdef APEP_USE_MPI
+    MPI_Waitall(nrequests, requests, MPI_STATUSES_IGNORE);
+#endif
+    nrequests = 0;
+}
+
+float Domain::GlobalMin(const float value) const {
+#ifdef APEP_USE_MPI
+    if (size > 1) {
+        float result;
+        MPI_Allreduce(&value, &result, 1, MPI_FLOAT, MPI_MIN, MPI_COMM_WORLD);
+        return result;
+    }
+#endif
+    return value;
+}
+
+double Domain::GlobalSum(const double value) const {
+#ifdef APEP_USE_MPI
+    if (size > 1) {
+        double result;
+        MPI_Allreduce(&value, &result, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        return result;
+    }
+#endif
+    return value;
+}
+
+void Domain::Gather(const Field2D &local, const int nx, const int nghost, Field2D &global) const {
+    // Pack the interior rows, then place them by global row
+    std::vector<float> send(static_cast<size_t>(nx) * ny);
+    for (int j = 0; j < ny; j++) {
+        std::memcpy(send.data() + static_cast<size_t>(j) * nx, local.Row(j + nghost) + nghost, nx * sizeof(float));
+    }
+    std::vector<float> recv;
+#ifdef APEP_USE_MPI
+    if (size > 1) {
+        std::vector<int> counts(size), displs(size);
+        for (int r = 0; r < size; r++) {
+            const long j0 = static_cast<long>(ny_global) * r / size;
+            const long j1 = static_cast<long>(ny_global) * (r + 1) / size;
+            counts[r] = static_cast<int>((j1 - j0) * nx);
+            displs[r] = static_cast<int>(j0 * nx);
+        }
+        if (rank == 0) {
+            recv.resize(static_cast<size_t>(nx) * ny_global);
+        }
+        MPI_Gatherv(send.data(), static_cast<int>(send.size()), MPI_FLOAT, recv.data(), counts.data(), displs.data(),
+                    MPI_FLOAT, 0, MPI_COMM_WORLD);
+    } else {
+        recv = std::move(send);
+    }
+#else
+    recv = std::move(send);
+#endif
+    if (rank != 0) {
+        return;
+    }
+    if (global.nx != nx || global.ny != ny_global) {
+        global.Resize(nx, ny_global);
+    }
+    for (int j = 0; j < ny_global; j++) {
+        std::memcpy(global.Row(j), recv.data() + static_cast<size_t>(j) * nx, nx * sizeof(float));
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef APEP_HYDRO_DOMAIN_H
+#define APEP_HYDRO_DOMAIN_H
+
+#include "Field.h"
+
+#ifdef APEP_USE_MPI
+#include <mpi.h>
+#endif
+
+// Starts and stops MPI when the build has it (APEP_WITH_MPI), no-ops otherwise. A grid built
+// without calling DomainInit runs as a single rank.
+void DomainInit(int *argc, char ***argv);
+
+void DomainFinalize();
+
+// Rank of this process among those DomainInit started, 0 without MPI
+int DomainRank();
+
+// Split of the grid rows over the MPI ranks. Every rank owns a slab of whole rows with rank 0 at
+// the bottom, so halo messages are contiguous rows of the fields and x stays periodic locally.
+struct Domain {
+    int rank = 0;
+    int size = 1;
+    int ny_global = 0; // Interior rows over all ranks
+    int j_offset = 0; // First global row of this rank
+    int ny = 0; // Rows owned by this rank
+    int lower = -1, upper = -1; // Neighbouring ranks, -1 where the slab ends at a wall
+
+    // Assigns this rank its rows out of ny_global. Every rank needs at least nghost rows, or the
+    // halo rows it sends would overlap the ones it receives. Returns false and reports on
+    // stderr when a rank gets fewer.
+    bool Decompose(int ny_global, int nghost);
+
+    // Sends the first and last nghost interior rows of the fields to the neighbours and posts
+    // the receives into the ghost rows. Nothing else may touch those rows until
+    // FinishHaloExchange returns.
+    void StartHaloExchange(Field2D *const (&fields)[4], int nghost);
+
+    void FinishHaloExchange();
+
+    // Reductions over all ranks
+    float GlobalMin(float value) const;
+
+    double GlobalSum(double value) const;
+
+    // Collects the nx interior columns of every rank's rows into global on rank 0, sized
+    // nx * ny_global without ghost cells. Other ranks leave global untouched.
+    void Gather(const Field2D &local, int nx, int nghost, Field2D &global) const;
+
+private:
+#ifdef APEP_USE_MPI
+    MPI_Request requests[16];
+#endif
+    int nrequests = 0;
+};
+
+#endif //APEP_HYDRO_DOMAIN_H
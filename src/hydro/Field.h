@@ -0,0 +1,120 @@
+#ifndef APEP_HYDRO_FIELD_H
+#define APEP_HYDRO_FIELD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+// Alignment of every field row, one cache line
+static constexpr int FIELD_ALIGN = 64;
+static constexpr int FIELD_ALIGN_FLOATS = FIELD_ALIGN / sizeof(float);
+
+// Number of field buffers allocated so far. Stepping a grid that has already been sized
+// must leave this unchanged.
+inline std::atomic<size_t> field_allocation_count{0};
+
+// Round n up to a whole number of cache lines worth of floats
+inline int PaddedStride(const int n) {
+    return (n + FIELD_ALIGN_FLOATS - 1) / FIELD_ALIGN_FLOATS * FIELD_ALIGN_FLOATS;
+}
+
+// 2D scalar field backed by a single allocation.
+// Rows run along x and are padded to a multiple of a cache line, so cell (i, j) lives at
+// data[j * stride + i] and every row starts on a 64-byte boundary.
+struct Field2D {
+    int nx = 0, ny = 0;
+    int stride = 0; // Row length in floats, including padding
+    float *data = nullptr;
+
+    Field2D() = default;
+
+    Field2D(const int nx, const int ny) {
+        Resize(nx, ny);
+    }
+
+    Field2D(const Field2D &other) {
+        *this = other;
+    }
+
+    Field2D(Field2D &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    ~Field2D() {
+        std::free(data);
+    }
+
+    Field2D &operator=(const Field2D &other) {
+        if (this != &other) {
+            // Reuse the existing buffer when the shapes match
+            if (nx != other.nx || ny != other.ny) {
+                Resize(other.nx, other.ny);
+            }
+            if (data != nullptr) {
+                std::memcpy(data, other.data, Size() * sizeof(float));
+            }
+        }
+        return *this;
+    }
+
+    Field2D &operator=(Field2D &&other) noexcept {
+        if (this != &other) {
+            std::free(data);
+            nx = std::exchange(other.nx, 0);
+            ny = std::exchange(other.ny, 0);
+            stride = std::exchange(other.stride, 0);
+            data = std::exchange(other.data, nullptr);
+        }
+        return *this;
+    }
+
+    // Reallocates the field and sets every cell (and the padding) to zero
+    void Resize(const int nx, const int ny) {
+        std::free(data);
+        data = nullptr;
+        this->nx = nx;
+        this->ny = ny;
+        this->stride = PaddedStride(nx);
+        const size_t bytes = Size() * sizeof(float);
+        if (bytes > 0) {
+            data = static_cast<float *>(std::aligned_alloc(FIELD_ALIGN, bytes));
+            if (data == nullptr) {
+                throw std::bad_alloc();
+            }
+            field_allocation_count.fetch_add(1, std::memory_order_relaxed);
+            std::memset(data, 0, bytes);
+        }
+    }
+
+    void Fill(const float value) {
+        for (size_t k = 0; k < Size(); k++) {
+            data[k] = value;
+        }
+    }
+
+    // Number of floats in the allocation, including row padding
+    size_t Size() const {
+        return static_cast<size_t>(stride) * ny;
+    }
+
+    float &operator()(const int i, const int j) {
+        return data[static_cast<size_t>(j) * stride + i];
+    }
+
+    const float &operator()(const int i, const int j) const {
+        return data[static_cast<size_t>(j) * stride + i];
+    }
+
+    float *Row(const int j) {
+        return data + static_cast<size_t>(j) * stride;
+    }
+
+    const float *Row(const int j) const {
+        return data + static_cast<size_t>(j) * stride;
+    }
+};
+
+#endif //APEP_HYDRO_FIELD_H
@@ -0,0 +1,165 @@
+#include "FrameWriter.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool WritePPM(const std::string &filename, const int width, const int height, const uint8_t *rgb) {
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file %s\n", filename.c_str());
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    const size_t bytes = static_cast<size_t>(width) * height * 3;
+    const bool ok = fwrite(rgb, 1, bytes, file) == bytes;
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Error writing file %s\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void put_u32_be(std::vector<uint8_t> &out, const uint32_t v) {
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+bool WriteQOI(const std::string &filename, const int width, const int height, const uint8_t *rgb) {
+    constexpr uint8_t QOI_OP_INDEX = 0x00, QOI_OP_DIFF = 0x40, QOI_OP_LUMA = 0x80, QOI_OP_RUN = 0xc0;
+    constexpr uint8_t QOI_OP_RGB = 0xfe;
+    std::vector<uint8_t> out;
+    out.reserve(static_cast<size_t>(width) * height + 64);
+    out.insert(out.end(), {'q', 'o', 'i', 'f'});
+    put_u32_be(out, width);
+    put_u32_be(out, height);
+    out.push_back(3); // RGB
+    out.push_back(0); // sRGB with linear alpha
+
+    // Every pixel is opaque, so alpha never changes and only enters the hash. The index keeps
+    // it anyway: its slots start as (0, 0, 0, 0) in the decoder, which no opaque pixel matches.
+    uint8_t seen[64][4] = {};
+    uint8_t prev[3] = {0, 0, 0};
+    int run = 0;
+    const size_t npixels = static_cast<size_t>(width) * height;
+    for (size_t p = 0; p < npixels; p++) {
+        const uint8_t *px = rgb + 3 * p;
+        if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2]) {
+            run++;
+            if (run == 62 || p + 1 == npixels) {
+                out.push_back(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+        const uint8_t rgba[4] = {px[0], px[1], px[2], 255};
+        const int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+        if (std::memcmp(seen[hash], rgba, 4) == 0) {
+            out.push_back(QOI_OP_INDEX | hash);
+        } else {
+            std::memcpy(seen[hash], rgba, 4);
+            const int8_t dr = static_cast<int8_t>(px[0] - prev[0]);
+            const int8_t dg = static_cast<int8_t>(px[1] - prev[1]);
+            const int8_t db = static_cast<int8_t>(px[2] - prev[2]);
+            const int8_t dr_dg = static_cast<int8_t>(dr - dg);
+            const int8_t db_dg = static_cast<int8_t>(db - dg);
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                out.push_back(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+            } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                out.push_back(QOI_OP_LUMA | (dg + 32));
+                out.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+            } else {
+                out.insert(out.end(), {QOI_OP_RGB, px[0], px[1], px[2]});
+            }
+        }
+        std::memcpy(prev, px, 3);
+    }
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file %s\n", filename.c_str());
+        return false;
+    }
+    const bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Error writing file %s\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+Y4mWriter::~Y4mWriter() {
+    Close();
+}
+
+bool Y4mWriter::Open(const std::string &filename, const int width, const int height, const int fps) {
+    Close();
+    file = fopen(filename.c_str(), "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file %s\n", filename.c_str());
+        return false;
+    }
+    this->width = width;
+    this->height = height;
+    const size_t cw = (width + 1) / 2, ch = (height + 1) / 2;
+    planes.resize(static_cast<size_t>(width) * height + 2 * cw * ch);
+    // C420jpeg only gives the chroma siting, the range has to be said on its own
+    fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, std::max(fps, 1));
+    return true;
+}
+
+bool Y4mWriter::Write(const uint8_t *rgb) {
+    if (file == nullptr) {
+        return false;
+    }
+    const int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    uint8_t *y_plane = planes.data();
+    uint8_t *cb_plane = y_plane + static_cast<size_t>(width) * height;
+    uint8_t *cr_plane = cb_plane + static_cast<size_t>(cw) * ch;
+    // Full range BT.601 in 16 bit fixed point
+    for (size_t p = 0; p < static_cast<size_t>(width) * height; p++) {
+        const int r = rgb[3 * p], g = rgb[3 * p + 1], b = rgb[3 * p + 2];
+        y_plane[p] = static_cast<uint8_t>((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+    }
+    // Chroma of every 2x2 block from its mean color
+    for (int cy = 0; cy < ch; cy++) {
+        for (int cx = 0; cx < cw; cx++) {
+            int r = 0, g = 0, b = 0, n = 0;
+            for (int y = 2 * cy; y < std::min(2 * cy + 2, height); y++) {
+                for (int x = 2 * cx; x < std::min(2 * cx + 2, width); x++) {
+                    const uint8_t *px = rgb + 3 * (static_cast<size_t>(y) * width + x);
+                    r += px[0];
+                    g += px[1];
+                    b += px[2];
+                    n++;
+                }
+            }
+            r /= n;
+            g /= n;
+            b /= n;
+            const int cb = (-11059 * r - 21709 * g + 32768 * b + (128 << 16) + 32768) >> 16;
+            const int cr = (32768 * r - 27439 * g - 5329 * b + (128 << 16) + 32768) >> 16;
+            cb_plane[cy * cw + cx] = static_cast<uint8_t>(std::clamp(cb, 0, 255));
+            cr_plane[cy * cw + cx] = static_cast<uint8_t>(std::clamp(cr, 0, 255));
+        }
+    }
+    fputs("FRAME\n", file);
+    if (fwrite(planes.data(), 1, planes.size(), file) != planes.size()) {
+        fprintf(stderr, "Error writing video frame\n");
+        return false;
+    }
+    return true;
+}
+
+void Y4mWriter::Close() {
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+}
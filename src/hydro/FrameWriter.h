@@ -0,0 +1,42 @@
+#ifndef APEP_HYDRO_FRAMEWRITER_H
+#define APEP_HYDRO_FRAMEWRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writers for RGB frames, 3 bytes per pixel with the top row first. They return false and
+// report on stderr when the file cannot be written.
+
+// Binary PPM (P6), readable by nearly every image tool
+bool WritePPM(const std::string &filename, int width, int height, const uint8_t *rgb);
+
+// QOI, lossless and usually a fraction of the PPM size, see qoiformat.org
+bool WriteQOI(const std::string &filename, int width, int height, const uint8_t *rgb);
+
+// Uncompressed YUV 4:2:0 stream in the YUV4MPEG2 container, one frame per Write. Full range
+// BT.601 like JPEG, marked with XCOLORRANGE=FULL so ffmpeg -i frames.y4m out.mp4 keeps the
+// range instead of taking it for limited.
+struct Y4mWriter {
+    Y4mWriter() = default;
+
+    Y4mWriter(const Y4mWriter &) = delete;
+
+    Y4mWriter &operator=(const Y4mWriter &) = delete;
+
+    ~Y4mWriter();
+
+    bool Open(const std::string &filename, int width, int height, int fps);
+
+    bool Write(const uint8_t *rgb);
+
+    void Close();
+
+private:
+    FILE *file = nullptr;
+    int width = 0, height = 0;
+    std::vector<uint8_t> planes; // Y, then Cb and Cr at half resolution in both directions
+};
+
+#endif //APEP_HYDRO_FRAMEWRITER_H
@@ -1,119 +1,18 @@
 #include "Grid.h"
+#include "Kernels.h"
+#include "Pipeline.h"
 #include "Reconstruct.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <string>
+#include <thread>
 #include <valarray>
 
-#include "Image.h"
 #include "Settings.h"
-
-#include "imgui.h"
-#include "implot.h"
-
-static constexpr float ALPHA[2][3] = {
-    {1.0f, 0.0f, 1.0f},
-    {0.5f, 0.5f, 0.5f}
-};
-
-void Grid::Update() {
-    Image image(nghost, nx, ny, rho);
-    auto image_size = image.GetWindowSize();
-
-    static float scale_min = 0;
-    static float scale_max = 3.0f;
-
-    static ImPlotColormap map = ImPlotColormap_Viridis;
-    if (ImPlot::ColormapButton(ImPlot::GetColormapName(map), ImVec2(225, 0), map)) {
-        map = (map + 1) % ImPlot::GetColormapCount();
-        // We bust the color cache of our plots so that item colors will
-        // resample the new colormap in the event that they have already
-        // been created. See documentation in implot.h.
-        ImPlot::BustColorCache("##Heatmap1");
-        ImPlot::BustColorCache("##Heatmap2");
-    }
-
-    ImGui::SameLine();
-    ImGui::LabelText("##Colormap Index", "%s", "Change Colormap");
-    ImGui::SetNextItemWidth(225);
-    ImGui::DragFloatRange2("Min / Max", &scale_min, &scale_max, 0.01f, -20, 20);
-    ImGui::Text("Current Time: %.3f", time);
-    ImGui::Text(("Current dt: %.3f"), dt);
-    ImGui::Text("Current dlx: %.3f", dlx);
-    ImGui::Text("Current dly: %.3f", dly);
-    if (reconstruct_type == ReconstructType::CONSTANT) {
-        ImGui::Text("Reconstruction: Constant");
-    } else {
-        ImGui::Text("Reconstruction: Linear");
-    }
-
-    // Display image size
-    ImGui::Text("Image Size: %.0f x %.0f", image_size.x, image_size.y);
-    ImGui::Text("Image Grid Size: %.0f x %.0f", image.nx, image.ny);
-    if (ImGui::Button("Print Grid")) {
-        image.Print();
-    }
-
-    if (ImGui::Button("Save Grid")) {
-        WriteGrid();
-    }
-
-    static ImPlotAxisFlags axes_flags = ImPlotAxisFlags_Lock | ImPlotAxisFlags_NoGridLines |
-                                        ImPlotAxisFlags_NoTickMarks;
-
-    ImPlot::PushColormap(map);
-
-    if (ImGui::BeginTabBar("Images", ImGuiTabBarFlags_None)) {
-        if (ImGui::BeginTabItem("rho")) {
-            if (ImPlot::BeginPlot("##Heatmap1", image_size, ImPlotFlags_NoLegend | ImPlotFlags_NoMouseText)) {
-                ImPlot::SetupAxes(nullptr, nullptr, axes_flags, axes_flags);
-                ImPlot::PlotHeatmap("heat", image.GetImage(), image.nx, image.ny, scale_min, scale_max, nullptr,
-                                    ImPlotPoint(0, 0), ImPlotPoint(1, 1));
-                ImPlot::EndPlot();
-            }
-            ImGui::SameLine();
-            ImPlot::ColormapScale("##HeatScale", scale_min, scale_max, ImVec2(60, image_size.y));
-            ImGui::EndTabItem();
-        }
-        if (ImGui::BeginTabItem("u")) {
-            Image image_u(nghost, nx, ny, u);
-            if (ImPlot::BeginPlot("##Heatmap1", image_size, ImPlotFlags_NoLegend | ImPlotFlags_NoMouseText)) {
-                ImPlot::SetupAxes(nullptr, nullptr, axes_flags, axes_flags);
-                ImPlot::PlotHeatmap("heat", image_u.GetImage(), image.nx, image.ny, scale_min, scale_max, nullptr,
-                                    ImPlotPoint(0, 0), ImPlotPoint(1, 1));
-                ImPlot::EndPlot();
-            }
-            ImGui::SameLine();
-            ImPlot::ColormapScale("##HeatScale", scale_min, scale_max, ImVec2(60, image_size.y));
-            ImGui::EndTabItem();
-        }
-        if (ImGui::BeginTabItem("v")) {
-            Image image_v(nghost, nx, ny, v);
-            if (ImPlot::BeginPlot("##Heatmap1", image_size, ImPlotFlags_NoLegend | ImPlotFlags_NoMouseText)) {
-                ImPlot::SetupAxes(nullptr, nullptr, axes_flags, axes_flags);
-                ImPlot::PlotHeatmap("heat", image_v.GetImage(), image.nx, image.ny, scale_min, scale_max, nullptr,
-                                    ImPlotPoint(0, 0), ImPlotPoint(1, 1));
-                ImPlot::EndPlot();
-            }
-            ImGui::SameLine();
-            ImPlot::ColormapScale("##HeatScale", scale_min, scale_max, ImVec2(60, image_size.y));
-            ImGui::EndTabItem();
-        }
-        if (ImGui::BeginTabItem("en")) {
-            Image image_en(nghost, nx, ny, en);
-            if (ImPlot::BeginPlot("##Heatmap1", image_size, ImPlotFlags_NoLegend | ImPlotFlags_NoMouseText)) {
-                ImPlot::SetupAxes(nullptr, nullptr, axes_flags, axes_flags);
-                ImPlot::PlotHeatmap("heat", image_en.GetImage(), image.nx, image.ny, scale_min, scale_max, nullptr,
-                                    ImPlotPoint(0, 0), ImPlotPoint(1, 1));
-                ImPlot::EndPlot();
-            }
-            ImGui::SameLine();
-            ImPlot::ColormapScale("##HeatScale", scale_min, scale_max, ImVec2(60, image_size.y));
-            ImGui::EndTabItem();
-        }
-        ImGui::EndTabBar();
-    }
-}
+#include "Trace.h"
 
 Grid::Grid(RTSettings &settings) {
     Reset(settings);
@@ -122,20 +21,38 @@ Grid::Grid(RTSettings &settings) {
 void Grid::Reset(RTSettings &settings) {
     AttrsFromSettings(settings);
     Resize();
+    amr.Configure(*this, settings.amr, settings.amr_block, settings.amr_criterion, settings.amr_threshold,
+                  settings.amr_regrid);
     RTInstability();
     PrimToCons();
+    if (amr.enabled) {
+        amr.Regrid(*this);
+    }
+    if (dt_type != DT_FIXED) {
+        // Start from the signal speeds of the initial state, without a growth limit
+        dt = 0.0f;
+        SetTimeStep(MaxSignalRate());
+    }
 }
 
 void Grid::Clear() {
-    delete reconstructor;
-    delete riemann_solver;
+    // Release the field memory, Reset sizes everything again
+    rho = Field2D();
+    en = Field2D();
+    u = Field2D();
+    v = Field2D();
+    gx = Field2D();
+    gy = Field2D();
+    cons = QVec2();
+    workspace = Workspace();
+    amr = Amr();
 }
 
 void Grid::AttrsFromSettings(RTSettings &settings) {
     this->nx = settings.nx;
-    this->ny = settings.ny;
     this->nghost = settings.nghost;
     this->reconstruct_type = settings.reconstruct_type;
+    this->limiter_type = settings.limiter_type;
     if (this->reconstruct_type == CONSTANT && this->nghost < 1) {
         this->nghost = 1;
         settings.nghost = 1;
@@ -143,6 +60,13 @@ void Grid::AttrsFromSettings(RTSettings &settings) {
         this->nghost = 2;
         settings.nghost = 2;
     }
+    // With MPI this rank only holds its slab of the rows. The split is the same on every rank,
+    // so when it does not work all of them stop here.
+    if (!domain.Decompose(settings.ny, nghost)) {
+        DomainFinalize();
+        std::exit(EXIT_FAILURE);
+    }
+    this->ny = domain.ny;
     this->nxg = nx + 2 * nghost;
     this->nyg = ny + 2 * nghost;
     this->nxmg = nxg - nghost;
@@ -160,32 +84,34 @@ void Grid::AttrsFromSettings(RTSettings &settings) {
     this->dlx = (settings.x2 - settings.x1) / settings.nx;
     this->dly = (settings.y2 - settings.y1) / settings.ny;
     this->time = 0.0f;
+    this->step = 0;
     this->cfl = settings.cfl;
     this->dt = 0.5 * cfl * std::min(dlx, dly) / 3.5;
+    this->dt_type = settings.dt_type;
+    this->dt_growth = settings.dt_growth;
     this->gamma_ad = settings.gamma_ad;
     this->riemann_solver_type = settings.riemann_solver_type;
-    // Delete the old reconstructor and create a new one
-    this->reconstructor = new Reconstructor(nx, ny, nghost, reconstruct_type);
-    this->riemann_solver = new RiemannSolver(nx, ny, nghost, riemann_solver_type);
     this->rkstages = settings.rkstages;
+    this->tile_nx = settings.tile_nx;
+    this->tile_ny = settings.tile_ny;
+    this->nthreads = settings.nthreads > 0 ? settings.nthreads : std::max(1u, std::thread::hardware_concurrency());
+    if (!pool || pool->Size() != nthreads) {
+        pool = std::make_unique<ThreadPool>(nthreads);
+    }
+    profiler.Resize(nthreads);
+    this->step_function = SelectStepFunction(reconstruct_type, limiter_type, riemann_solver_type, rkstages);
 }
 
 void Grid::Resize() {
-    rho.resize(nxg);
-    en.resize(nxg);
-    u.resize(nxg);
-    v.resize(nxg);
-    gx.resize(nxg);
-    gy.resize(nxg);
-    for (int i = 0; i < nxg; i++) {
-        rho[i].resize(nyg);
-        en[i].resize(nyg);
-        u[i].resize(nyg);
-        v[i].resize(nyg);
-        gx[i].resize(nyg);
-        gy[i].resize(nyg);
-    }
+    rho.Resize(nxg, nyg);
+    en.Resize(nxg, nyg);
+    u.Resize(nxg, nyg);
+    v.Resize(nxg, nyg);
+    gx.Resize(nxg, nyg);
+    gy.Resize(nxg, nyg);
     cons.Resize(nx, ny);
+    workspace.Resize(nx, ny, nghost, tile_nx, tile_ny);
+    step_allocations = 0;
 }
 
 void Grid::RTInstability() {
@@ -193,212 +119,229 @@ void Grid::RTInstability() {
     for (int j = 0; j < ny; j++) {
         for (int i = 0; i < nx; i++) {
             const float xi = x1 + dlx * ((i + 1) - 0.5f);
-            const float yj = y1 + dly * ((j + 1) - 0.5f);
+            const float yj = y1 + dly * ((j + domain.j_offset + 1) - 0.5f);
 
-            gx[i + nghost][j + nghost] = grav_x_ini;
-            gy[i + nghost][j + nghost] = grav_y_ini;
+            gx(i + nghost, j + nghost) = grav_x_ini;
+            gy(i + nghost, j + nghost) = grav_y_ini;
             if (yj <= 0.0f) {
-                rho[i + nghost][j + nghost] = rho_ini_lower;
+                rho(i + nghost, j + nghost) = rho_ini_lower;
             } else {
-                rho[i + nghost][j + nghost] = rho_ini_upper;
+                rho(i + nghost, j + nghost) = rho_ini_upper;
             }
-            en[i + nghost][j + nghost] = en_ini + gy[i + nghost][j + nghost] * yj * rho[i + nghost][j + nghost];
-            u[i + nghost][j + nghost] = 0.0f;
-            v[i + nghost][j + nghost] = perturb_strength * (1.0f + std::cos(4.0f * M_PI * xi)) * (
+            en(i + nghost, j + nghost) = en_ini + gy(i + nghost, j + nghost) * yj * rho(i + nghost, j + nghost);
+            u(i + nghost, j + nghost) = 0.0f;
+            v(i + nghost, j + nghost) = perturb_strength * (1.0f + std::cos(4.0f * M_PI * xi)) * (
                                             1.0f + std::cos(3.0f * M_PI * yj)) /
                                         4.0f;
         }
     }
 }
 
-void Grid::WriteGrid() {
-    const std::string filename = "grid.txt";
-
-    FILE *file = fopen(filename.c_str(), "w");
-    if (file == NULL) {
-        fprintf(stderr, "Error opening file %s\n", filename.c_str());
-    }
-    // Write a line containing the variable name, followed by the values
-    fprintf(file, "# Density\n");
-    for (int i = nghost; i < nxmg; i++) {
-        for (int j = nghost; j < nymg; j++) {
-            fprintf(file, "%f ", rho[i][j]);
-        }
-        fprintf(file, "\n");
-    }
-    fprintf(file, "# Energy\n");
-    for (int i = nghost; i < nxmg; i++) {
-        for (int j = nghost; j < nymg; j++) {
-            fprintf(file, "%f ", en[i][j]);
-        }
-        fprintf(file, "\n");
-    }
-    fprintf(file, "# Velocity x\n");
-    for (int i = nghost; i < nxmg; i++) {
-        for (int j = nghost; j < nymg; j++) {
-            fprintf(file, "%f ", u[i][j]);
-        }
-        fprintf(file, "\n");
-    }
-    fprintf(file, "# Velocity y\n");
-    for (int i = nghost; i < nxmg; i++) {
-        for (int j = nghost; j < nymg; j++) {
-            fprintf(file, "%f ", v[i][j]);
+void Grid::Capture(Snapshot &snapshot) {
+    if (amr.enabled) {
+        amr.Composite(*this, snapshot);
+        snapshot.refinement = AMR_RATIO;
+    } else {
+        Field2D *const fields[4] = {&rho, &u, &v, &en};
+        Field2D *snapshot_fields[4] = {&snapshot.rho, &snapshot.u, &snapshot.v, &snapshot.en};
+        for (int k = 0; k < 4; k++) {
+            domain.Gather(*fields[k], nx, nghost, *snapshot_fields[k]);
         }
-        fprintf(file, "\n");
+        snapshot.refinement = 1;
     }
-    fclose(file);
+    snapshot.nx = nx * snapshot.refinement;
+    snapshot.ny = domain.ny_global * snapshot.refinement;
+    snapshot.time = time;
+    snapshot.dt = dt;
+    snapshot.x1 = x1;
+    snapshot.x2 = x2;
+    snapshot.y1 = y1;
+    snapshot.y2 = y2;
+    snapshot.dlx = dlx / snapshot.refinement;
+    snapshot.dly = dly / snapshot.refinement;
+    snapshot.gamma_ad = gamma_ad;
+    snapshot.cfl = cfl;
+    snapshot.grav_x = grav_x_ini;
+    snapshot.grav_y = grav_y_ini;
+    snapshot.step = step;
+    snapshot.reconstruct_type = reconstruct_type;
+    snapshot.limiter_type = limiter_type;
+    snapshot.riemann_solver_type = riemann_solver_type;
+    snapshot.rkstages = rkstages;
+    snapshot.dt_type = dt_type;
+    snapshot.nthreads = nthreads;
+    snapshot.ntiles = static_cast<int>(workspace.tiles.size());
+    snapshot.tile_nx = tile_nx;
+    snapshot.tile_ny = tile_ny;
+    snapshot.step_allocations = step_allocations;
+    snapshot.amr_patches = static_cast<int>(amr.active.size());
+    snapshot.amr_block = amr.block;
+}
+
+bool Grid::WriteGrid(const std::string &filename) {
+    // Every rank sends its rows, rank 0 writes the whole grid
+    Snapshot snapshot;
+    Capture(snapshot);
+    const bool ok = domain.rank != 0 || snapshot.Write(filename);
+    return domain.GlobalMin(ok ? 1.0f : 0.0f) > 0.0f;
 }
 
 void Grid::PrimToCons() {
-    for (int i = 0; i < nx; i++) {
-        for (int j = 0; j < ny; j++) {
-            cons.rho[i][j] = rho[i + nghost][j + nghost];
-            cons.u[i][j] = rho[i + nghost][j + nghost] * u[i + nghost][j + nghost];
-            cons.v[i][j] = rho[i + nghost][j + nghost] * v[i + nghost][j + nghost];
-            cons.en[i][j] = en[i + nghost][j + nghost] * (1 / (gamma_ad - 1))
-                            + 0.5f * rho[i + nghost][j + nghost] * (std::pow(u[i + nghost][j + nghost], 2) + std::pow(
-                                                                        v[i + nghost][j + nghost], 2));
+    PrimToCons(0, nx, 0, ny);
+}
+
+void Grid::PrimToCons(const int ibegin, const int iend, const int jbegin, const int jend) {
+    for (int j = jbegin; j < jend; j++) {
+        const float *rho_row = rho.Row(j + nghost) + nghost;
+        const float *u_row = u.Row(j + nghost) + nghost;
+        const float *v_row = v.Row(j + nghost) + nghost;
+        const float *en_row = en.Row(j + nghost) + nghost;
+        float *crho = cons.rho.Row(j);
+        float *cu = cons.u.Row(j);
+        float *cv = cons.v.Row(j);
+        float *cen = cons.en.Row(j);
+        for (int i = ibegin; i < iend; i++) {
+            crho[i] = rho_row[i];
+            cu[i] = rho_row[i] * u_row[i];
+            cv[i] = rho_row[i] * v_row[i];
+            cen[i] = en_row[i] * (1 / (gamma_ad - 1))
+                     + 0.5f * rho_row[i] * (std::pow(u_row[i], 2) + std::pow(v_row[i], 2));
         }
     }
 }
 
 void Grid::ConsToPrim() {
-    for (int i = 0; i < nx; i++) {
-        for (int j = 0; j < ny; j++) {
-            const float rho_new = cons.rho[i][j] > 0.0f ? cons.rho[i][j] : 1.0e-6f;
-            u[i + nghost][j + nghost] = cons.u[i][j] / rho_new;
-            v[i + nghost][j + nghost] = cons.v[i][j] / rho_new;
-            en[i + nghost][j + nghost] =
-                    (gamma_ad - 1) * (cons.en[i][j] - 0.5 / rho_new * (
-                                          std::pow(cons.u[i][j], 2) + std::pow(cons.v[i][j], 2)));
-            rho[i + nghost][j + nghost] = rho_new;
+    ConsToPrim(0, nx, 0, ny);
+}
+
+void Grid::ConsToPrim(const int ibegin, const int iend, const int jbegin, const int jend) {
+    for (int j = jbegin; j < jend; j++) {
+        float *rho_row = rho.Row(j + nghost) + nghost;
+        float *u_row = u.Row(j + nghost) + nghost;
+        float *v_row = v.Row(j + nghost) + nghost;
+        float *en_row = en.Row(j + nghost) + nghost;
+        const float *crho = cons.rho.Row(j);
+        const float *cu = cons.u.Row(j);
+        const float *cv = cons.v.Row(j);
+        const float *cen = cons.en.Row(j);
+        for (int i = ibegin; i < iend; i++) {
+            const float rho_new = crho[i] > 0.0f ? crho[i] : 1.0e-6f;
+            u_row[i] = cu[i] / rho_new;
+            v_row[i] = cv[i] / rho_new;
+            en_row[i] = (gamma_ad - 1) * (cen[i] - 0.5 / rho_new * (std::pow(cu[i], 2) + std::pow(cv[i], 2)));
+            rho_row[i] = rho_new;
         }
     }
 }
 
-void Grid::TimeStep() {
-    // Advance one time step
-    PrimToCons();
-
-    QVec2 cons0(nx, ny);
-    for (int i = 0; i < nx; i++) {
-        for (int j = 0; j < ny; j++) {
-            cons0.rho[i][j] = rho[i + nghost][j + nghost];
-            cons0.u[i][j] = rho[i + nghost][j + nghost] * u[i + nghost][j + nghost];
-            cons0.v[i][j] = rho[i + nghost][j + nghost] * v[i + nghost][j + nghost];
-            cons0.en[i][j] = en[i + nghost][j + nghost] * (1 / (gamma_ad - 1))
-                             + 0.5f * rho[i + nghost][j + nghost] * (std::pow(u[i + nghost][j + nghost], 2) +
-                                                                     std::pow(v[i + nghost][j + nghost], 2));
+void Grid::GravitySource(Tile &tile) {
+    for (int j = 0; j < tile.ny; j++) {
+        const float *gx_row = gx.Row(tile.j0 + j + nghost) + tile.i0 + nghost;
+        const float *gy_row = gy.Row(tile.j0 + j + nghost) + tile.i0 + nghost;
+        const float *rho_row = tile.rho.Row(j + nghost) + nghost;
+        const float *u_row = tile.u.Row(j + nghost) + nghost;
+        const float *v_row = tile.v.Row(j + nghost) + nghost;
+        float *res_u = tile.res.u.Row(j);
+        float *res_v = tile.res.v.Row(j);
+        float *res_en = tile.res.en.Row(j);
+        for (int i = 0; i < tile.nx; i++) {
+            res_u[i] -= gx_row[i] * rho_row[i];
+            res_v[i] -= gy_row[i] * rho_row[i];
+            res_en[i] -= (gx_row[i] * u_row[i] + gy_row[i] * v_row[i]) * rho_row[i];
         }
     }
+}
 
-    for (int it = 0; it < rkstages; it++) {
-        // First, apply boundary conditions
-        ApplyBoundaryConditions();
+void Grid::TimeStep() {
+    APEP_TRACE_SCOPE_ARG("TimeStep", step);
+    const size_t allocations = field_allocation_count.load(std::memory_order_relaxed);
+    const bool profiling = profiler.Enabled();
+    const auto start = profiling ? Profiler::Clock::now() : Profiler::Clock::time_point();
 
-        QVec2 res(nx, ny);
+    // Advance one time step
+    const float dt_step = dt;
+    step_function(*this);
+    time += dt_step;
+    step++;
+
+    step_allocations = field_allocation_count.load(std::memory_order_relaxed) - allocations;
+    if (profiling) {
+        profiler.AddStep(std::chrono::duration<double>(Profiler::Clock::now() - start).count());
+    }
+}
 
-        // Calculate the fluxes in x direction
-        for (int j = 0; j < ny; j++) {
-            QVec qlx(nx + 1), qrx(nx + 1), qx(nxg);
-            QVec fluxx(nx + 1);
-            for (int i = 0; i < nxg; i++) {
-                qx.Set(i, rho[i][j + nghost], u[i][j + nghost], v[i][j + nghost], en[i][j + nghost]);
-            }
-            reconstructor->Reconstruct(qx, qlx, qrx, XDIR);
-            riemann_solver->Solve(qlx, qrx, fluxx, gamma_ad, XDIR);
-            for (int i = 0; i < nx; i++) {
-                res.rho[i][j] += (fluxx.rho[i + 1] - fluxx.rho[i]) / dlx;
-                res.u[i][j] += (fluxx.u[i + 1] - fluxx.u[i]) / dlx;
-                res.v[i][j] += (fluxx.v[i + 1] - fluxx.v[i]) / dlx;
-                res.en[i][j] += (fluxx.en[i + 1] - fluxx.en[i]) / dlx;
-            }
-        }
+void Grid::TimeStep(const float t_end) {
+    if (time + dt < t_end) {
+        TimeStep();
+        return;
+    }
+    const float dt_full = dt;
+    dt = t_end - time;
+    TimeStep();
+    // t_end - time is rounded, land on t_end itself
+    time = t_end;
+    if (dt_type == DT_FIXED) {
+        dt = dt_full;
+    }
+}
 
-        // Calculate the fluxes in y direction
-        for (int i = 0; i < nx; i++) {
-            QVec qly(ny + 1), qry(ny + 1), qy(nyg);
-            QVec fluxy(ny + 1);
-            for (int j = 0; j < nyg; j++) {
-                qy.Set(j, rho[i + nghost][j], u[i + nghost][j], v[i + nghost][j], en[i + nghost][j]);
-            }
-            reconstructor->Reconstruct(qy, qly, qry, YDIR);
-            qly.FlipVelocities(1);
-            qry.FlipVelocities(1);
-            riemann_solver->Solve(qly, qry, fluxy, gamma_ad, YDIR);
-            fluxy.FlipVelocities(-1);
-            for (int j = 0; j < ny; j++) {
-                res.rho[i][j] += (fluxy.rho[j + 1] - fluxy.rho[j]) / dly;
-                res.u[i][j] += (fluxy.u[j + 1] - fluxy.u[j]) / dly;
-                res.v[i][j] += (fluxy.v[j + 1] - fluxy.v[j]) / dly;
-                res.en[i][j] += (fluxy.en[j + 1] - fluxy.en[j]) / dly;
-            }
+void Grid::FillHalo(Tile &tile) {
+    // Copy the tile and its halo out of the grid, applying the boundary conditions to the
+    // halo cells that fall outside the domain. Periodic in x, reflecting in y. Rows past the
+    // slab of a neighbouring MPI rank come from the exchanged ghost rows instead.
+    const Field2D *fields[4] = {&rho, &en, &u, &v};
+    Field2D *tile_fields[4] = {&tile.rho, &tile.en, &tile.u, &tile.v};
+    const int width = tile.nx + 2 * nghost;
+    // Columns of the halo row that lie inside the domain
+    const int ilo = std::max(0, nghost - tile.i0);
+    const int ihi = std::min(width, nx + nghost - tile.i0);
+    for (int jl = 0; jl < tile.ny + 2 * nghost; jl++) {
+        // Interior row the halo row is copied from. Rows past a wall mirror the ones inside it
+        // and only v flips sign.
+        int j = tile.j0 + jl - nghost;
+        bool mirrored = false;
+        if (j < 0 && domain.lower < 0) {
+            j = -1 - j;
+            mirrored = true;
+        } else if (j >= ny && domain.upper < 0) {
+            j = 2 * ny - 1 - j;
+            mirrored = true;
         }
-
-        // Gravity update
-        // TODO: Move this to it's own function
-        for (int i = 0; i < nx; i++) {
-            for (int j = 0; j < ny; j++) {
-                res.u[i][j] -= gx[i + nghost][j + nghost] * rho[i + nghost][j + nghost];
-                res.v[i][j] -= gy[i + nghost][j + nghost] * rho[i + nghost][j + nghost];
-                res.en[i][j] -= (gx[i + nghost][j + nghost] * u[i + nghost][j + nghost] +
-                                 gy[i + nghost][j + nghost] * v[i + nghost][j + nghost]) * rho[i + nghost][j + nghost];
+        for (int n = 0; n < 4; n++) {
+            const float sgn = mirrored && fields[n] == &v ? -1.0f : 1.0f;
+            const float *src = fields[n]->Row(j + nghost) + tile.i0;
+            float *dst = tile_fields[n]->Row(jl);
+            for (int i = ilo; i < ihi; i++) {
+                dst[i] = sgn * src[i];
             }
-        }
-
-        // Integrate result
-        // TODO: Move this to it's own function
-        for (int i = 0; i < nx; i++) {
-            for (int j = 0; j < ny; j++) {
-                cons.rho[i][j] = ALPHA[it][0] * cons0.rho[i][j] + ALPHA[it][1] * cons.rho[i][j] - ALPHA[it][2] * res.rho
-                                 [i][j] * dt;
-                cons.u[i][j] = ALPHA[it][0] * cons0.u[i][j] + ALPHA[it][1] * cons.u[i][j] - ALPHA[it][2] * res.u[i][j] *
-                               dt;
-                cons.v[i][j] = ALPHA[it][0] * cons0.v[i][j] + ALPHA[it][1] * cons.v[i][j] - ALPHA[it][2] * res.v[i][j] *
-                               dt;
-                cons.en[i][j] = ALPHA[it][0] * cons0.en[i][j] + ALPHA[it][1] * cons.en[i][j] - ALPHA[it][2] * res.en[i][
-                                    j] * dt;
+            // Halo columns past the left or right edge wrap around
+            for (int i = 0; i < ilo; i++) {
+                dst[i] = sgn * src[i + nx];
+            }
+            for (int i = ihi; i < width; i++) {
+                dst[i] = sgn * src[i - nx];
             }
         }
-        ConsToPrim();
     }
 }
 
-void Grid::ApplyBoundaryConditions() {
-    // Apply boundary conditions
-    // Periodic in x, reflecting in y
-
-    // x-direction
-    for (int j = 0; j < nyg; j++) {
-        for (int ig = 0; ig < nghost; ig++) {
-            // Left boundary
-            rho[ig][j] = rho[nx + ig][j];
-            en[ig][j] = en[nx + ig][j];
-            u[ig][j] = u[nx + ig][j];
-            v[ig][j] = v[nx + ig][j];
-            // Right boundary
-            rho[nx + nghost + ig][j] = rho[nghost + ig][j];
-            en[nx + nghost + ig][j] = en[nghost + ig][j];
-            u[nx + nghost + ig][j] = u[nghost + ig][j];
-            v[nx + nghost + ig][j] = v[nghost + ig][j];
-        }
+float Grid::MaxSignalRate() const {
+    float max_rate = 0.0f;
+    for (int j = 0; j < ny; j++) {
+        max_rate = std::max(max_rate, max_signal_rate(rho.Row(j + nghost) + nghost, u.Row(j + nghost) + nghost,
+                                                      v.Row(j + nghost) + nghost, en.Row(j + nghost) + nghost,
+                                                      nx, gamma_ad, 1.0f / dlx, 1.0f / dly));
     }
+    return max_rate;
+}
 
-    // y-direction
-    for (int i = 0; i < nxg; i++) {
-        for (int jg = 0; jg < nghost; jg++) {
-            // Bottom boundary
-            rho[i][nghost - 1 - jg] = rho[i][nghost + jg];
-            en[i][nghost - 1 - jg] = en[i][nghost + jg];
-            u[i][nghost - 1 - jg] = u[i][nghost + jg];
-            v[i][nghost - 1 - jg] = -v[i][nghost + jg];
-            // Top boundary
-            rho[i][ny + nghost + jg] = rho[i][ny + nghost - 1 - jg];
-            en[i][ny + nghost + jg] = en[i][ny + nghost - 1 - jg];
-            u[i][ny + nghost + jg] = u[i][ny + nghost - 1 - jg];
-            v[i][ny + nghost + jg] = -v[i][ny + nghost - 1 - jg];
-        }
+void Grid::SetTimeStep(const float max_rate) {
+    if (dt_type == DT_FIXED) {
+        return;
     }
+    float dt_new = max_rate > 0.0f ? cfl / max_rate : dt;
+    if (dt > 0.0f && dt_growth > 0.0f) {
+        dt_new = std::min(dt_new, dt * dt_growth);
+    }
+    dt = domain.GlobalMin(dt_new);
 }
-
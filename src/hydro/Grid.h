@@ -1,18 +1,34 @@
 #ifndef APEP_HYDRO_GRID_H
 #define APEP_HYDRO_GRID_H
-#include <vector>
+#include <memory>
+#include <string>
 
+#include "Amr.h"
+#include "Domain.h"
+#include "Field.h"
 #include "Hydro.h"
+#include "Pipeline.h"
+#include "Profiler.h"
 #include "Reconstruct.h"
 #include "RiemannSolver.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+#include "Workspace.h"
+
+enum TimeStepType {
+    DT_FIXED = 0, // 0.5 * cfl * min(dlx, dly) / 3.5, set once
+    DT_CELLS = 1, // cfl over the largest (|u| + c) / dlx + (|v| + c) / dly of the cells
+    DT_RIEMANN = 2, // Same with the wave speeds of the Riemann solver at the interfaces
+};
 
 struct Grid {
-    std::vector<std::vector<float> > rho;
-    std::vector<std::vector<float> > en;
-    std::vector<std::vector<float> > u;
-    std::vector<std::vector<float> > v;
-    std::vector<std::vector<float> > gx;
-    std::vector<std::vector<float> > gy;
+    // Primitive variables and gravity, including ghost cells. Indexed as field(i, j).
+    Field2D rho;
+    Field2D en;
+    Field2D u;
+    Field2D v;
+    Field2D gx;
+    Field2D gy;
     QVec2 cons;
     int nx, ny, nghost;
     int nxg, nyg; // nxg = nx + 2 * nghost, nyg = ny + 2 * nghost
@@ -23,33 +39,82 @@ struct Grid {
     float perturb_strength;
     float x1, x2, y1, y2, dlx, dly;
     float time, dt;
+    int dt_type;
+    float dt_growth; // Largest factor dt may grow by per step
+    long step; // Time steps since the last reset
     float cfl;
     float gamma_ad;
     int reconstruct_type;
+    int limiter_type;
     int riemann_solver_type;
     int rkstages; // Number of Runge-Kutta stages
-    Reconstructor *reconstructor;
-    RiemannSolver *riemann_solver;
+    StepFunction step_function; // TimeStep specialization picked from the settings in Reset
+    int nthreads; // Solver threads, including the calling one
+    std::unique_ptr<ThreadPool> pool;
+    int tile_nx, tile_ny; // Cells per tile in each direction
+    Workspace workspace;
+    Domain domain; // Rows of the global grid held by this MPI rank, ny counts only those
+    size_t step_allocations; // Field allocations made by the last TimeStep, should stay 0
+    Amr amr; // Refined patches over the base grid
+    Profiler profiler; // Phase timers of TimeStep, off unless enabled
 
     ~Grid() = default;
 
     void Clear();
 
-    void Update();
+    // Copies the interior state and step info into snapshot. Collective over the MPI ranks,
+    // only rank 0 receives the fields. With AMR the fields are the composite grid at the fine
+    // resolution.
+    void Capture(Snapshot &snapshot);
 
     void Resize();
 
-    void WriteGrid();
+    // Writes the whole grid as a binary snapshot file. Collective over the MPI ranks, only rank 0
+    // writes, and every rank gets false if it failed.
+    bool WriteGrid(const std::string &filename);
+
+    // Writes a checkpoint the run can continue from, see Checkpoint.h. Collective over the MPI
+    // ranks, only rank 0 writes, and every rank gets false if it failed.
+    bool WriteCheckpoint(const std::string &filename);
+
+    // Continues from a checkpoint. The grid must have been reset with the settings from
+    // ReadCheckpointSettings. Every rank reads its own rows, so the number of ranks may differ
+    // from the run that wrote the file.
+    bool ReadCheckpoint(const std::string &filename);
 
-    // Functions for converting between conserved and primitive variables
+    // Functions for converting between conserved and primitive variables, on all interior
+    // cells or on columns [ibegin, iend) of rows [jbegin, jend)
     void PrimToCons();
 
+    void PrimToCons(int ibegin, int iend, int jbegin, int jend);
+
     void ConsToPrim();
 
+    void ConsToPrim(int ibegin, int iend, int jbegin, int jend);
+
     // Hydrodynamics functions
+
+    // Advances the grid and time by dt, then picks dt for the next step
     void TimeStep();
 
-    void ApplyBoundaryConditions();
+    // Like TimeStep, but shortens the step to end exactly at t_end when a full one would pass
+    // it, so runs stop at the same time whatever their resolution. A fixed dt is kept for later
+    // steps, an adaptive one grows back from the shortened step at dt_growth.
+    void TimeStep(float t_end);
+
+    // Largest (|u| + c) / dlx + (|v| + c) / dly over the interior cells of this rank
+    float MaxSignalRate() const;
+
+    // Sets dt from the largest signal rate over the grid, limited to dt_growth times the
+    // previous step and reduced over the MPI ranks. Does nothing for DT_FIXED.
+    void SetTimeStep(float max_rate);
+
+    // Copies the primitive variables of a tile and its halo from the grid. Halo cells outside
+    // the domain get the boundary conditions, so this replaces a global boundary pass.
+    void FillHalo(Tile &tile);
+
+    // Adds the gravity source terms of the tile cells to the tile residual
+    void GravitySource(Tile &tile);
 
     // Functions for RT Instability
     Grid(struct RTSettings &settings);
@@ -1,13 +1,13 @@
 #ifndef APEP_HYDRO_HYDRO_H
 #define APEP_HYDRO_HYDRO_H
 
-#include <vector>
+#include "Field.h"
 
 struct QVec2 {
-    std::vector<std::vector<float> > rho;
-    std::vector<std::vector<float> > u;
-    std::vector<std::vector<float> > v;
-    std::vector<std::vector<float> > en;
+    Field2D rho;
+    Field2D u;
+    Field2D v;
+    Field2D en;
 
     ~QVec2() = default;
 
@@ -18,54 +18,43 @@ struct QVec2 {
     }
 
     void Resize(const int nx, const int ny) {
-        rho.resize(nx);
-        u.resize(nx);
-        v.resize(nx);
-        en.resize(nx);
-        for (int i = 0; i < nx; i++) {
-            rho[i].resize(ny);
-            u[i].resize(ny);
-            v[i].resize(ny);
-            en[i].resize(ny);
-        }
+        rho.Resize(nx, ny);
+        u.Resize(nx, ny);
+        v.Resize(nx, ny);
+        en.Resize(nx, ny);
     }
 };
 
+// One pencil of the four variables. The components are rows of a single Field2D allocation.
 struct QVec {
-    std::vector<float> rho;
-    std::vector<float> u;
-    std::vector<float> v;
-    std::vector<float> en;
+    float *rho = nullptr;
+    float *u = nullptr;
+    float *v = nullptr;
+    float *en = nullptr;
+    int n = 0;
+    Field2D storage;
 
-    QVec(const size_t n) {
-        rho.resize(n);
-        u.resize(n);
-        v.resize(n);
-        en.resize(n);
-    }
+    QVec() = default;
 
-    void Set(const int i, const float rho, const float u, const float v, const float en) {
-        this->rho[i] = rho;
-        this->u[i] = u;
-        this->v[i] = v;
-        this->en[i] = en;
+    QVec(const int n) {
+        Resize(n);
     }
 
-    void Set(const std::vector<float> &rho, const std::vector<float> &u, const std::vector<float> &v,
-             const std::vector<float> &en) {
-        this->rho = rho;
-        this->u = u;
-        this->v = v;
-        this->en = en;
-    }
+    QVec(const QVec &) = delete;
+
+    QVec &operator=(const QVec &) = delete;
+
+    QVec(QVec &&) = default;
+
+    QVec &operator=(QVec &&) = default;
 
-    void FlipVelocities(const int sgn) {
-        for (size_t i = 0; i < u.size(); i++) {
-            const float u_tmp = u[i];
-            const float v_tmp = v[i];
-            u[i] = sgn * v_tmp;
-            v[i] = -1 * sgn * u_tmp;
-        }
+    void Resize(const int n) {
+        this->n = n;
+        storage.Resize(n, 4);
+        rho = storage.Row(0);
+        u = storage.Row(1);
+        v = storage.Row(2);
+        en = storage.Row(3);
     }
 };
 
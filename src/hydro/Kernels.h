@@ -0,0 +1,315 @@
+#ifndef APEP_HYDRO_KERNELS_H
+#define APEP_HYDRO_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "Hydro.h"
+#include "Reconstruct.h"
+#include "RiemannSolver.h"
+#include "Simd.h"
+
+// Per-interface building blocks of the hydro pipeline. They are templates over the lane type
+// (VFloat or float, see Simd.h) and are kept in a header so Pipeline.cpp can inline the whole
+// reconstruct -> solve chain into one loop. Reconstructor and RiemannSolver wrap the same code.
+
+// The four variables of one or more interfaces, held in registers
+template<typename T>
+struct QLanes {
+    T rho, u, v, en;
+};
+
+inline int sign(const float val) {
+    return std::signbit(val) ? -1 : 1;
+}
+
+template<typename T>
+inline QLanes<T> load_lanes(const QVec &q, const int i) {
+    using L = Lanes<T>;
+    return {L::Load(q.rho + i), L::Load(q.u + i), L::Load(q.v + i), L::Load(q.en + i)};
+}
+
+template<typename T>
+inline void store_lanes(QVec &q, const int i, const QLanes<T> &a) {
+    using L = Lanes<T>;
+    L::Store(q.rho + i, a.rho);
+    L::Store(q.u + i, a.u);
+    L::Store(q.v + i, a.v);
+    L::Store(q.en + i, a.en);
+}
+
+// Limited slope from the backward and forward differences. Branch free: both the limiter and
+// the extremum test are lane selects.
+template<int LIM, typename T>
+inline T limited_slope(const T dql, const T dqr) {
+    using L = Lanes<T>;
+    const T zero = L::Set1(0.0f);
+    const T adql = simd_abs(dql);
+    const T adqr = simd_abs(dqr);
+    // Slopes of opposite sign mark an extremum, where the reconstruction is flat
+    const typename L::Mask monotone = dql * dqr > zero;
+    if constexpr (LIM == MINMOD) {
+        return simd_select(monotone, simd_select(adql < adqr, dql, dqr), zero);
+    } else if constexpr (LIM == MC) {
+        const T mag = simd_min(simd_min(adql, adqr) * L::Set1(2.0f), L::Set1(0.5f) * simd_abs(dql + dqr));
+        return simd_select(monotone, simd_select(dql > zero, mag, zero - mag), zero);
+    } else {
+        // van Leer, guard the denominator where the slope is discarded anyway
+        const T den = simd_select(monotone, dql + dqr, L::Set1(1.0f));
+        return simd_select(monotone, L::Set1(2.0f) * dql * dqr / den, zero);
+    }
+}
+
+// Left and right state of one variable at the interfaces starting at i
+template<int RCT, int LIM, typename T>
+inline void reconstruct_variable(const Stencil &s, const int i, T &ql, T &qr) {
+    using L = Lanes<T>;
+    const T qm1 = L::Load(s.m1 + i);
+    const T q0 = L::Load(s.c0 + i);
+    if constexpr (RCT == CONSTANT) {
+        ql = qm1;
+        qr = q0;
+    } else {
+        const T half = L::Set1(0.5f);
+        const T qm2 = L::Load(s.m2 + i);
+        const T qp1 = L::Load(s.p1 + i);
+        const T dq = q0 - qm1;
+        ql = qm1 + half * limited_slope<LIM>(qm1 - qm2, dq);
+        qr = q0 - half * limited_slope<LIM>(dq, qp1 - q0);
+    }
+}
+
+template<int RCT, int LIM, typename T>
+inline void reconstruct_lanes(const Stencil (&s)[4], const int i, QLanes<T> &ql, QLanes<T> &qr) {
+    reconstruct_variable<RCT, LIM>(s[0], i, ql.rho, qr.rho);
+    reconstruct_variable<RCT, LIM>(s[1], i, ql.u, qr.u);
+    reconstruct_variable<RCT, LIM>(s[2], i, ql.v, qr.v);
+    reconstruct_variable<RCT, LIM>(s[3], i, ql.en, qr.en);
+}
+
+// Reference HLLC flux of a single interface. Blends both star states through sign() and
+// evaluates some terms in double, as the original solver did. speed is set to the largest
+// signal speed magnitude, max(|sl|, |sr|).
+inline QLanes<float> hllc_reference(const QLanes<float> &ql, const QLanes<float> &qr, const float gamma_ad,
+                                    float &speed) {
+    // Left states
+    const float rhol = ql.rho;
+    const float ul = ql.u;
+    const float vl = ql.v;
+    const float pl = ql.en;
+    const float vel2l = ul * ul + vl * vl;
+    const float el = pl / (gamma_ad - 1) + 0.5f * rhol * vel2l;
+
+    // Right states
+    const float rhor = qr.rho;
+    const float ur = qr.u;
+    const float vr = qr.v;
+    const float pr = qr.en;
+    const float vel2r = ur * ur + vr * vr;
+    const float er = pr / (gamma_ad - 1) + 0.5f * rhor * vel2r;
+
+    const float cl = gamma_ad * pl / rhol;
+    const float cr = gamma_ad * pr / rhor;
+
+    const float cmax = std::sqrt(std::max(cl, cr));
+
+    const float sl = std::min(ul, ur) - cmax;
+    const float sr = std::max(ul, ur) + cmax;
+    speed = std::max(-sl, sr);
+
+    const float dsul = sl - ul;
+    const float dsur = sr - ur;
+
+    const float ustar = (pr - pl + rhol * ul * dsul - rhor * ur * dsur) / (rhol * dsul - rhor * dsur);
+
+    const float rhobar = 0.5 * (rhol + rhor);
+    const float cbar = std::sqrt(0.5 * (cl + cr));
+
+    const float pstar = 0.5 * (pl + pr) - 0.5 * rhobar * cbar * (ur - ul);
+
+    const int sgn = sign(ustar);
+
+    const float rhostarl = rhol * (dsul / (sl - ustar));
+    const float estarl = rhostarl * (el / rhol + (ustar - ul) * (ustar + pl / rhol / dsul));
+
+    const float rhostarr = rhor * (dsur / (sr - ustar));
+    const float estarr = rhostarr * (er / rhor + (ustar - ur) * (ustar + pr / rhor / dsur));
+
+    const float onemsignh = 0.5 * (1.0 - sgn);
+    const float onepsignh = 0.5 * (1.0 + sgn);
+
+    const float rhostar = onepsignh * rhostarl + onemsignh * rhostarr;
+    const float rhoustar = rhostar * ustar;
+
+    // Calculate fluxes
+    return {
+        rhoustar,
+        rhoustar * ustar + pstar,
+        rhoustar * (onepsignh * vl + onemsignh * vr),
+        (onepsignh * estarl + onemsignh * estarr + pstar) * ustar
+    };
+}
+
+// HLLC flux with the upwind star state picked by a lane mask, T is VFloat or float. speed is
+// set to max(|sl|, |sr|) per lane.
+template<typename T>
+inline QLanes<T> hllc_lanes(const QLanes<T> &ql, const QLanes<T> &qr, const float gamma_ad, T &speed) {
+    using L = Lanes<T>;
+    const T zero = L::Set1(0.0f);
+    const T half = L::Set1(0.5f);
+    const T gamma = L::Set1(gamma_ad);
+    const T gm1_inv = L::Set1(1.0f / (gamma_ad - 1.0f));
+
+    const T cl = gamma * ql.en / ql.rho;
+    const T cr = gamma * qr.en / qr.rho;
+    const T cmax = simd_sqrt(simd_max(cl, cr));
+
+    const T sl = simd_min(ql.u, qr.u) - cmax;
+    const T sr = simd_max(ql.u, qr.u) + cmax;
+    speed = simd_max(zero - sl, sr);
+    const T dsul = sl - ql.u;
+    const T dsur = sr - qr.u;
+
+    const T ustar = (qr.en - ql.en + ql.rho * ql.u * dsul - qr.rho * qr.u * dsur) /
+                    (ql.rho * dsul - qr.rho * dsur);
+
+    const T rhobar = half * (ql.rho + qr.rho);
+    const T cbar = simd_sqrt(half * (cl + cr));
+    const T pstar = half * (ql.en + qr.en) - half * rhobar * cbar * (qr.u - ql.u);
+
+    // Pick the upwind side first so only one star state has to be evaluated
+    const typename L::Mask left = ustar >= zero;
+    const T rhok = simd_select(left, ql.rho, qr.rho);
+    const T uk = simd_select(left, ql.u, qr.u);
+    const T vk = simd_select(left, ql.v, qr.v);
+    const T pk = simd_select(left, ql.en, qr.en);
+    const T sk = simd_select(left, sl, sr);
+    const T dsuk = simd_select(left, dsul, dsur);
+    const T ek = pk * gm1_inv + half * rhok * (uk * uk + vk * vk);
+
+    const T rhostar = rhok * (dsuk / (sk - ustar));
+    const T estar = rhostar * (ek / rhok + (ustar - uk) * (ustar + pk / rhok / dsuk));
+    const T rhoustar = rhostar * ustar;
+
+    return {rhoustar, rhoustar * ustar + pstar, rhoustar * vk, (estar + pstar) * ustar};
+}
+
+// HLLE flux with Einfeldt's wave speed estimates: the extreme of the one-sided signal speeds
+// and the Roe-averaged ones. Cheaper and more diffusive than HLLC, no contact wave. speed is
+// set to max(|bm|, |bp|) per lane.
+template<typename T>
+inline QLanes<T> hlle_lanes(const QLanes<T> &ql, const QLanes<T> &qr, const float gamma_ad, T &speed) {
+    using L = Lanes<T>;
+    const T zero = L::Set1(0.0f);
+    const T half = L::Set1(0.5f);
+    const T gamma = L::Set1(gamma_ad);
+    const T gm1 = L::Set1(gamma_ad - 1.0f);
+    const T gm1_inv = L::Set1(1.0f / (gamma_ad - 1.0f));
+
+    // Total energy and enthalpy of both sides
+    const T el = ql.en * gm1_inv + half * ql.rho * (ql.u * ql.u + ql.v * ql.v);
+    const T er = qr.en * gm1_inv + half * qr.rho * (qr.u * qr.u + qr.v * qr.v);
+    const T one = L::Set1(1.0f);
+    const T rhol_inv = one / ql.rho;
+    const T rhor_inv = one / qr.rho;
+    const T hl = (el + ql.en) * rhol_inv;
+    const T hr = (er + qr.en) * rhor_inv;
+
+    // Roe averages
+    const T sqrl = simd_sqrt(ql.rho);
+    const T sqrr = simd_sqrt(qr.rho);
+    const T winv = one / (sqrl + sqrr);
+    const T uroe = (sqrl * ql.u + sqrr * qr.u) * winv;
+    const T vroe = (sqrl * ql.v + sqrr * qr.v) * winv;
+    const T hroe = (sqrl * hl + sqrr * hr) * winv;
+    const T croe = simd_sqrt(simd_max(gm1 * (hroe - half * (uroe * uroe + vroe * vroe)), zero));
+
+    const T cl = simd_sqrt(gamma * ql.en * rhol_inv);
+    const T cr = simd_sqrt(gamma * qr.en * rhor_inv);
+    const T bm = simd_min(simd_min(ql.u - cl, uroe - croe), zero);
+    const T bp = simd_max(simd_max(qr.u + cr, uroe + croe), zero);
+    speed = simd_max(zero - bm, bp);
+    const T bpm = bp * bm;
+    const T den = one / (bp - bm);
+
+    // F = (bp * F_l - bm * F_r + bp * bm * (U_r - U_l)) / (bp - bm)
+    const T mul = ql.rho * ql.u;
+    const T mur = qr.rho * qr.u;
+    return {
+        (bp * mul - bm * mur + bpm * (qr.rho - ql.rho)) * den,
+        (bp * (mul * ql.u + ql.en) - bm * (mur * qr.u + qr.en) + bpm * (mur - mul)) * den,
+        (bp * mul * ql.v - bm * mur * qr.v + bpm * (qr.rho * qr.v - ql.rho * ql.v)) * den,
+        (bp * (el + ql.en) * ql.u - bm * (er + qr.en) * qr.u + bpm * (er - el)) * den
+    };
+}
+
+// Flux of Riemann solver RS, with its largest signal speed magnitude in speed. The reference
+// HLLC only exists for float lanes.
+template<int RS, typename T>
+inline QLanes<T> riemann_flux(const QLanes<T> &ql, const QLanes<T> &qr, const float gamma_ad, T &speed) {
+    if constexpr (RS == HLLC) {
+        return hllc_reference(ql, qr, gamma_ad, speed);
+    } else if constexpr (RS == HLLC_SIMD) {
+        return hllc_lanes(ql, qr, gamma_ad, speed);
+    } else {
+        return hlle_lanes(ql, qr, gamma_ad, speed);
+    }
+}
+
+// Fused reconstruction and Riemann solve for n interfaces of a pencil. The interface states
+// stay in registers, only the fluxes are written out. Returns the largest signal speed
+// magnitude the solver saw over the pencil.
+template<int RCT, int LIM, int RS>
+inline float solve_pencil(const Stencil (&s)[4], QVec &flux, const int n, const float gamma_ad) {
+    int i = 0;
+    float max_speed = 0.0f;
+    if constexpr (RS != HLLC) {
+        VFloat max_speeds = simd_set1(0.0f);
+        for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH) {
+            QLanes<VFloat> ql, qr;
+            VFloat speed;
+            reconstruct_lanes<RCT, LIM>(s, i, ql, qr);
+            store_lanes(flux, i, riemann_flux<RS>(ql, qr, gamma_ad, speed));
+            max_speeds = simd_max(max_speeds, speed);
+        }
+        max_speed = simd_hmax(max_speeds);
+    }
+    // Scalar tail
+    for (; i < n; i++) {
+        QLanes<float> ql, qr;
+        float speed;
+        reconstruct_lanes<RCT, LIM>(s, i, ql, qr);
+        store_lanes(flux, i, riemann_flux<RS>(ql, qr, gamma_ad, speed));
+        max_speed = std::max(max_speed, speed);
+    }
+    return max_speed;
+}
+
+// (|u| + c) / dlx + (|v| + c) / dly of cells with primitive variables rho, u, v and pressure p.
+// The stable time step of the unsplit update is cfl over the largest of these.
+template<typename T>
+inline T signal_rate(const T rho, const T u, const T v, const T p, const float gamma_ad, const float inv_dlx,
+                     const float inv_dly) {
+    using L = Lanes<T>;
+    const T c = simd_sqrt(L::Set1(gamma_ad) * p / rho);
+    return (simd_abs(u) + c) * L::Set1(inv_dlx) + (simd_abs(v) + c) * L::Set1(inv_dly);
+}
+
+// Largest signal_rate over n cells of a row
+inline float max_signal_rate(const float *rho, const float *u, const float *v, const float *p, const int n,
+                             const float gamma_ad, const float inv_dlx, const float inv_dly) {
+    int i = 0;
+    VFloat max_rates = simd_set1(0.0f);
+    for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH) {
+        const VFloat rate = signal_rate(simd_load(rho + i), simd_load(u + i), simd_load(v + i), simd_load(p + i),
+                                        gamma_ad, inv_dlx, inv_dly);
+        max_rates = simd_max(max_rates, rate);
+    }
+    float max_rate = simd_hmax(max_rates);
+    for (; i < n; i++) {
+        max_rate = std::max(max_rate, signal_rate(rho[i], u[i], v[i], p[i], gamma_ad, inv_dlx, inv_dly));
+    }
+    return max_rate;
+}
+
+#endif //APEP_HYDRO_KERNELS_H
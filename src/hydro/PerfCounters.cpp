@@ -0,0 +1,124 @@
+#include "PerfCounters.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(APEP_USE_PERF_COUNTERS) && defined(__linux__)
+#define APEP_PERF_EVENTS
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#endif
+
+const char *CounterName(const int counter) {
+    static const char *names[COUNTER_COUNT] = {
+        "Cycles", "Instructions", "Cache misses", "Branch misses", "FP vector",
+    };
+    return counter >= 0 && counter < COUNTER_COUNT ? names[counter] : "";
+}
+
+#ifdef APEP_PERF_EVENTS
+// FP_ARITH_INST_RETIRED with the 128, 256 and 512 bit packed umasks, Broadwell and later
+static constexpr uint64_t INTEL_FP_VECTOR_EVENT = 0xFCC7;
+
+static bool intel_cpu() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    char vendor[13] = {};
+    if (__get_cpuid(0, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+    std::memcpy(vendor, &ebx, 4);
+    std::memcpy(vendor + 4, &edx, 4);
+    std::memcpy(vendor + 8, &ecx, 4);
+    return std::strcmp(vendor, "GenuineIntel") == 0;
+#else
+    return false;
+#endif
+}
+
+static int open_counter(const uint32_t type, const uint64_t config, const int group) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+#endif
+
+PerfCounters::~PerfCounters() {
+    Close();
+}
+
+bool PerfCounters::Open() {
+    Close();
+    tried = true;
+#ifdef APEP_PERF_EVENTS
+    const uint32_t types[COUNTER_COUNT] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_RAW,
+    };
+    const uint64_t configs[COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES, INTEL_FP_VECTOR_EVENT,
+    };
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        if (c == COUNTER_FP_VECTOR && !intel_cpu()) {
+            continue;
+        }
+        fds[c] = open_counter(types[c], configs[c], fds[COUNTER_CYCLES]);
+        if (fds[c] < 0 && c == COUNTER_CYCLES) {
+            return false; // No group to join, typically no PMU in a VM or a high perf_event_paranoid
+        }
+        if (fds[c] >= 0) {
+            slot[c] = nopen++;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PerfCounters::Close() {
+    for (int &fd: fds) {
+#ifdef APEP_PERF_EVENTS
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+        fd = -1;
+    }
+    nopen = 0;
+    tried = false;
+}
+
+void PerfCounters::Read(double *counts) const {
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        counts[c] = 0.0;
+    }
+#ifdef APEP_PERF_EVENTS
+    if (!IsOpen()) {
+        return;
+    }
+    // Number of counters, time enabled, time running, then one value per counter
+    uint64_t data[3 + COUNTER_COUNT];
+    const ssize_t size = read(fds[COUNTER_CYCLES], data, sizeof(data));
+    if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || data[0] != static_cast<uint64_t>(nopen) ||
+        data[2] == 0) {
+        return;
+    }
+    const double scale = static_cast<double>(data[1]) / static_cast<double>(data[2]);
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        if (fds[c] >= 0) {
+            counts[c] = static_cast<double>(data[3 + slot[c]]) * scale;
+        }
+    }
+#endif
+}
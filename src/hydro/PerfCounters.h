@@ -0,0 +1,57 @@
+#ifndef APEP_HYDRO_PERFCOUNTERS_H
+#define APEP_HYDRO_PERFCOUNTERS_H
+
+enum PerfCounterType {
+    COUNTER_CYCLES = 0,
+    COUNTER_INSTRUCTIONS = 1,
+    COUNTER_CACHE_MISSES = 2, // Last level cache
+    COUNTER_BRANCH_MISSES = 3,
+    COUNTER_FP_VECTOR = 4, // Packed floating point instructions, FMA counts twice. Intel only.
+    COUNTER_COUNT,
+};
+
+const char *CounterName(int counter);
+
+// Hardware counters of one thread through Linux perf_event_open, user space only. The counters
+// form one group, so they run over the same instructions and are read with one system call.
+// Counters the kernel, the CPU or perf_event_paranoid do not allow stay unavailable, and on
+// other systems, or without APEP_USE_PERF_COUNTERS, none are.
+struct PerfCounters {
+    PerfCounters() = default;
+
+    PerfCounters(const PerfCounters &) = delete;
+
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    ~PerfCounters();
+
+    // Counts the calling thread from now on. Returns false when no counter is available, and
+    // is not tried again until Close.
+    bool Open();
+
+    void Close();
+
+    bool Tried() const {
+        return tried;
+    }
+
+    bool IsOpen() const {
+        return fds[COUNTER_CYCLES] >= 0;
+    }
+
+    bool Available(const int counter) const {
+        return fds[counter] >= 0;
+    }
+
+    // Counts since Open of every counter, zero for unavailable ones. Scaled up to the full
+    // time when the kernel had to share the hardware counters with other groups.
+    void Read(double *counts) const;
+
+private:
+    int fds[COUNTER_COUNT] = {-1, -1, -1, -1, -1}; // The cycles counter leads the group
+    int slot[COUNTER_COUNT] = {}; // Position of the counter in the group read
+    int nopen = 0;
+    bool tried = false;
+};
+
+#endif //APEP_HYDRO_PERFCOUNTERS_H
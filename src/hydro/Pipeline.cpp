@@ -0,0 +1,403 @@
+#include "Pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "Amr.h"
+#include "Grid.h"
+#include "Kernels.h"
+#include "Profiler.h"
+#include "Trace.h"
+
+// Columns handled together by the y-sweep of a tile, sized so the stencil rows of a block stay
+// in L1/L2
+static constexpr int YSWEEP_BLOCK = 512;
+
+// Runge-Kutta coefficients per stage: q = a0 * q0 + a1 * q - a2 * dt * res
+static constexpr float ALPHA[2][3] = {
+    {1.0f, 0.0f, 1.0f},
+    {0.5f, 0.5f, 0.5f}
+};
+
+// Share of stage IT in the residual of a whole step of RK stages, q = q0 - dt * sum(w * res).
+// Weights the fluxes kept for the AMR flux correction.
+template<int IT, int RK>
+static constexpr float stage_weight() {
+    if constexpr (RK == 1) {
+        return ALPHA[0][2];
+    } else if constexpr (IT == 0) {
+        return ALPHA[0][2] * ALPHA[1][1];
+    } else {
+        return ALPHA[1][2];
+    }
+}
+
+// Flux divergence of direction DIR into the tile residual. The x-sweep initialises the
+// residual, the y-sweep adds to it. Returns the largest wave speed of the Riemann solves.
+// Every row of interface fluxes is also handed to record, see Amr.h.
+template<int DIR, int RCT, int LIM, int RS, typename REC>
+static float sweep(const Grid &g, const float dlx, const float dly, Tile &tile, REC &record) {
+    QVec &flux = tile.scratch.flux;
+    float max_speed = 0.0f;
+    QVec2 &res = tile.res;
+    const int nghost = g.nghost;
+    if constexpr (DIR == XDIR) {
+        // Rows are contiguous, so the stencils point straight into the fields without a gather
+        const Field2D *vars[4] = {&tile.rho, &tile.u, &tile.v, &tile.en};
+        for (int j = 0; j < tile.ny; j++) {
+            Stencil s[4];
+            for (int k = 0; k < 4; k++) {
+                const float *c0 = vars[k]->Row(j + nghost) + nghost;
+                if constexpr (RCT == CONSTANT) {
+                    s[k] = {nullptr, c0 - 1, c0, nullptr};
+                } else {
+                    s[k] = {c0 - 2, c0 - 1, c0, c0 + 1};
+                }
+            }
+            max_speed = std::max(max_speed, solve_pencil<RCT, LIM, RS>(s, flux, tile.nx + 1, g.gamma_ad));
+            record.X(j, flux);
+            float *res_rho = res.rho.Row(j);
+            float *res_u = res.u.Row(j);
+            float *res_v = res.v.Row(j);
+            float *res_en = res.en.Row(j);
+            for (int i = 0; i < tile.nx; i++) {
+                res_rho[i] = (flux.rho[i + 1] - flux.rho[i]) / dlx;
+                res_u[i] = (flux.u[i + 1] - flux.u[i]) / dlx;
+                res_v[i] = (flux.v[i + 1] - flux.v[i]) / dlx;
+                res_en[i] = (flux.en[i + 1] - flux.en[i]) / dlx;
+            }
+        }
+    } else {
+        // Walks the y-interfaces row by row over a block of adjacent columns, so the SIMD lanes
+        // run along x with unit stride and the four stencil rows stay in cache between
+        // interfaces. Normal and tangential velocity are swapped by passing v in the u slot,
+        // so the normal momentum flux comes back in flux.u and goes to the v residual.
+        const Field2D *vars[4] = {&tile.rho, &tile.v, &tile.u, &tile.en};
+        for (int ib = 0; ib < tile.nx; ib += YSWEEP_BLOCK) {
+            const int n = std::min(YSWEEP_BLOCK, tile.nx - ib);
+            for (int jf = 0; jf < tile.ny + 1; jf++) {
+                const int row = jf + nghost;
+                const int col = ib + nghost;
+                Stencil s[4];
+                for (int k = 0; k < 4; k++) {
+                    const Field2D &f = *vars[k];
+                    // The outer rows are never read by constant reconstruction, and with a single
+                    // ghost row they lie outside the field, so they are not formed at all
+                    if constexpr (RCT == CONSTANT) {
+                        s[k] = {nullptr, f.Row(row - 1) + col, f.Row(row) + col, nullptr};
+                    } else {
+                        s[k] = {f.Row(row - 2) + col, f.Row(row - 1) + col, f.Row(row) + col,
+                                f.Row(row + 1) + col};
+                    }
+                }
+                // Keep the flux of the previous interface row for the difference
+                std::swap(tile.scratch.flux, tile.scratch.flux_prev);
+                const QVec &flux_prev = tile.scratch.flux_prev;
+                max_speed = std::max(max_speed, solve_pencil<RCT, LIM, RS>(s, flux, n, g.gamma_ad));
+                record.Y(jf, ib, n, flux);
+                if (jf == 0) {
+                    continue;
+                }
+                float *res_rho = res.rho.Row(jf - 1) + ib;
+                float *res_u = res.u.Row(jf - 1) + ib;
+                float *res_v = res.v.Row(jf - 1) + ib;
+                float *res_en = res.en.Row(jf - 1) + ib;
+                for (int i = 0; i < n; i++) {
+                    res_rho[i] += (flux.rho[i] - flux_prev.rho[i]) / dly;
+                    res_u[i] += (flux.v[i] - flux_prev.v[i]) / dly;
+                    res_v[i] += (flux.u[i] - flux_prev.u[i]) / dly;
+                    res_en[i] += (flux.en[i] - flux_prev.en[i]) / dly;
+                }
+            }
+        }
+    }
+    return max_speed;
+}
+
+// Runge-Kutta update of stage IT on the tile cells, with the coefficients known at compile time.
+// The tile cells start at (i0, j0) of cons and cons0.
+template<int IT>
+static void integrate(QVec2 &cons, const QVec2 &cons0, const int i0, const int j0, const Tile &tile,
+                      const float dt) {
+    constexpr float a0 = ALPHA[IT][0];
+    constexpr float a1 = ALPHA[IT][1];
+    constexpr float a2 = ALPHA[IT][2];
+    Field2D *cons_fields[4] = {&cons.rho, &cons.u, &cons.v, &cons.en};
+    const Field2D *cons0_fields[4] = {&cons0.rho, &cons0.u, &cons0.v, &cons0.en};
+    const Field2D *res_fields[4] = {&tile.res.rho, &tile.res.u, &tile.res.v, &tile.res.en};
+    for (int j = 0; j < tile.ny; j++) {
+        for (int n = 0; n < 4; n++) {
+            float *q = cons_fields[n]->Row(j0 + j) + i0;
+            const float *q0 = cons0_fields[n]->Row(j0 + j) + i0;
+            const float *r = res_fields[n]->Row(j);
+            for (int i = 0; i < tile.nx; i++) {
+                if constexpr (a1 == 0.0f) {
+                    q[i] = a0 * q0[i] - a2 * r[i] * dt;
+                } else {
+                    q[i] = a0 * q0[i] + a1 * q[i] - a2 * r[i] * dt;
+                }
+            }
+        }
+    }
+}
+
+// Saves the conserved state of the tile cells at the start of the step
+static void save_cons(Grid &g, const Tile &tile) {
+    const Field2D *cons_fields[4] = {&g.cons.rho, &g.cons.u, &g.cons.v, &g.cons.en};
+    Field2D *cons0_fields[4] = {&g.workspace.cons0.rho, &g.workspace.cons0.u, &g.workspace.cons0.v,
+                                &g.workspace.cons0.en};
+    for (int j = tile.j0; j < tile.j0 + tile.ny; j++) {
+        for (int n = 0; n < 4; n++) {
+            std::memcpy(cons0_fields[n]->Row(j) + tile.i0, cons_fields[n]->Row(j) + tile.i0,
+                        tile.nx * sizeof(float));
+        }
+    }
+}
+
+// Largest signal rate over nx * ny cells of the primitive fields, starting at (i, j)
+static float cells_rate(const Grid &g, const Field2D &rho, const Field2D &u, const Field2D &v, const Field2D &en,
+                        const int i, const int j, const int nx, const int ny, const float dlx, const float dly) {
+    float max_rate = 0.0f;
+    for (int jj = j; jj < j + ny; jj++) {
+        max_rate = std::max(max_rate, max_signal_rate(rho.Row(jj) + i, u.Row(jj) + i, v.Row(jj) + i, en.Row(jj) + i,
+                                                      nx, g.gamma_ad, 1.0f / dlx, 1.0f / dly));
+    }
+    return max_rate;
+}
+
+// Every stage runs in two passes over the tiles. The first copies each tile and its halo out
+// of the grid, the second advances the tile from that copy and writes its own cells back.
+// Tiles only read other tiles' cells in the first pass, so no two tasks touch the same data.
+// The pool gives every thread the same tiles in both passes, so the copy is still in cache
+// when the tile is advanced. The last stage also leaves the largest signal rate of every tile
+// in Tile::max_rate for the next time step. With AMR the fluxes on block faces are kept with
+// the given stage weight.
+template<int RCT, int LIM, int RS, int IT, bool LAST>
+static void stage(Grid &g, const float weight) {
+    APEP_TRACE_SCOPE_ARG("Stage", IT);
+    std::vector<Tile> &tiles = g.workspace.tiles;
+    const int ntiles = static_cast<int>(tiles.size());
+
+    const auto fill = [&](const int t0, const int t1, const int thread) {
+        for (int t = t0; t < t1; t++) {
+            Tile &tile = tiles[t];
+            APEP_TRACE_SCOPE_ARG("Fill tile", t);
+            {
+                ScopedPhase timer(g.profiler, thread, PHASE_HALO);
+                g.FillHalo(tile);
+            }
+            if constexpr (IT == 0) {
+                ScopedPhase timer(g.profiler, thread, PHASE_PRIM_TO_CONS);
+                g.PrimToCons(tile.i0, tile.i0 + tile.nx, tile.j0, tile.j0 + tile.ny);
+                save_cons(g, tile);
+            }
+        }
+    };
+    if (g.domain.size == 1) {
+        g.pool->ParallelFor(0, ntiles, 1, fill);
+    } else {
+        // Only the first and last row of tiles read the ghost rows from the neighbouring ranks,
+        // so the others are filled while the messages are in flight
+        Field2D *const fields[4] = {&g.rho, &g.u, &g.v, &g.en};
+        const int inner_begin = std::min(g.workspace.tiles_x, ntiles);
+        const int inner_end = std::max(inner_begin, ntiles - g.workspace.tiles_x);
+        g.domain.StartHaloExchange(fields, g.nghost);
+        g.pool->ParallelFor(inner_begin, inner_end, 1, fill);
+        g.domain.FinishHaloExchange();
+        g.pool->ParallelFor(0, inner_begin, 1, fill);
+        g.pool->ParallelFor(inner_end, ntiles, 1, fill);
+    }
+
+    g.pool->ParallelFor(0, ntiles, 1, [&](const int t0, const int t1, const int thread) {
+        for (int t = t0; t < t1; t++) {
+            Tile &tile = tiles[t];
+            APEP_TRACE_SCOPE_ARG("Advance tile", t);
+            float speed_x, speed_y;
+            const auto sweeps = [&](auto &record) {
+                {
+                    ScopedPhase timer(g.profiler, thread, PHASE_SWEEP_X);
+                    speed_x = sweep<XDIR, RCT, LIM, RS>(g, g.dlx, g.dly, tile, record);
+                }
+                ScopedPhase timer(g.profiler, thread, PHASE_SWEEP_Y);
+                speed_y = sweep<YDIR, RCT, LIM, RS>(g, g.dlx, g.dly, tile, record);
+            };
+            if (g.amr.enabled) {
+                CoarseFluxRecord record{g.amr, tile, weight, IT == 0};
+                sweeps(record);
+            } else {
+                NoFluxRecord record;
+                sweeps(record);
+            }
+            {
+                ScopedPhase timer(g.profiler, thread, PHASE_SOURCE);
+                g.GravitySource(tile);
+            }
+            {
+                ScopedPhase timer(g.profiler, thread, PHASE_UPDATE);
+                integrate<IT>(g.cons, g.workspace.cons0, tile.i0, tile.j0, tile, g.dt);
+            }
+            {
+                ScopedPhase timer(g.profiler, thread, PHASE_CONS_TO_PRIM);
+                g.ConsToPrim(tile.i0, tile.i0 + tile.nx, tile.j0, tile.j0 + tile.ny);
+            }
+            if (!LAST || g.dt_type == DT_FIXED) {
+                continue;
+            }
+            ScopedPhase timer(g.profiler, thread, PHASE_TIME_STEP);
+            if (g.dt_type == DT_RIEMANN) {
+                tile.max_rate = speed_x / g.dlx + speed_y / g.dly;
+            } else {
+                // The new primitives of the tile were just written and are still in cache
+                tile.max_rate = cells_rate(g, g.rho, g.u, g.v, g.en, tile.i0 + g.nghost, tile.j0 + g.nghost, tile.nx,
+                                           tile.ny, g.dlx, g.dly);
+            }
+        }
+    });
+}
+
+// Stage IT of substep sub of the patches, the same two passes as stage() over the patches of
+// the fine level. Halos are taken at the time the stage starts.
+template<int RCT, int LIM, int RS, int RK, int IT, bool LAST>
+static void patch_stage(Grid &g, const int sub, const float dt) {
+    Amr &amr = g.amr;
+    const int npatches = static_cast<int>(amr.active.size());
+    const float theta = static_cast<float>(sub + IT) / AMR_RATIO;
+    const float dlx = g.dlx / AMR_RATIO;
+    const float dly = g.dly / AMR_RATIO;
+
+    g.pool->ParallelFor(0, npatches, 1, [&](const int p0, const int p1, int) {
+        for (int p = p0; p < p1; p++) {
+            Patch &patch = amr.patches[amr.active[p]];
+            amr.FillHalo(g, patch, theta);
+            if constexpr (IT == 0) {
+                patch.cons0 = patch.cons;
+            }
+        }
+    });
+
+    g.pool->ParallelFor(0, npatches, 1, [&](const int p0, const int p1, int) {
+        for (int p = p0; p < p1; p++) {
+            APEP_TRACE_SCOPE_ARG("Advance patch", p);
+            Patch &patch = amr.patches[amr.active[p]];
+            Tile &tile = patch.tile;
+            PatchFluxRecord record{patch, stage_weight<IT, RK>() / (AMR_RATIO * AMR_RATIO)};
+            const float speed_x = sweep<XDIR, RCT, LIM, RS>(g, dlx, dly, tile, record);
+            const float speed_y = sweep<YDIR, RCT, LIM, RS>(g, dlx, dly, tile, record);
+            amr.GravitySource(patch);
+            integrate<IT>(patch.cons, patch.cons0, 0, 0, tile, dt);
+            amr.ConsToPrim(g, patch);
+            if (!LAST || g.dt_type == DT_FIXED || sub != AMR_RATIO - 1) {
+                continue;
+            }
+            if (g.dt_type == DT_RIEMANN) {
+                tile.max_rate = speed_x / dlx + speed_y / dly;
+            } else {
+                tile.max_rate = cells_rate(g, tile.rho, tile.u, tile.v, tile.en, g.nghost, g.nghost, tile.nx, tile.ny,
+                                           dlx, dly);
+            }
+        }
+    });
+}
+
+// Advances the patches over the coarse step of length dt just taken by the base grid, in
+// AMR_RATIO substeps, then synchronizes the two levels. Returns the largest signal rate of the
+// patches scaled to the coarse step.
+template<int RCT, int LIM, int RS, int RK>
+static float amr_step(Grid &g, const float dt) {
+    APEP_TRACE_SCOPE("Refinement");
+    Amr &amr = g.amr;
+    amr.ClearFluxes();
+    for (int sub = 0; sub < AMR_RATIO; sub++) {
+        patch_stage<RCT, LIM, RS, RK, 0, RK == 1>(g, sub, dt / AMR_RATIO);
+        if constexpr (RK == 2) {
+            patch_stage<RCT, LIM, RS, RK, 1, true>(g, sub, dt / AMR_RATIO);
+        }
+    }
+    amr.Synchronize(g, dt);
+    float max_rate = 0.0f;
+    for (const int p: amr.active) {
+        max_rate = std::max(max_rate, amr.patches[p].tile.max_rate);
+    }
+    return max_rate / AMR_RATIO;
+}
+
+// Wall time since start, added to a phase the calling thread runs alone
+static void add_wall(Grid &g, const int phase, const Profiler::Clock::time_point start) {
+    if (g.profiler.Enabled()) {
+        g.profiler.AddWall(phase, std::chrono::duration<double>(Profiler::Clock::now() - start).count());
+    }
+}
+
+template<int RCT, int LIM, int RS, int RK>
+static void time_step(Grid &g) {
+    const float dt = g.dt;
+    const bool profiling = g.profiler.Enabled();
+    auto start = profiling ? Profiler::Clock::now() : Profiler::Clock::time_point();
+    if (g.amr.enabled) {
+        if (g.step > 0 && g.step % g.amr.regrid_interval == 0) {
+            g.amr.Regrid(g);
+        }
+        g.amr.SaveCoarse(g);
+        add_wall(g, PHASE_REFINEMENT, start);
+    }
+    stage<RCT, LIM, RS, 0, RK == 1>(g, stage_weight<0, RK>());
+    if constexpr (RK == 2) {
+        stage<RCT, LIM, RS, 1, true>(g, stage_weight<1, RK>());
+    }
+    float max_rate = 0.0f;
+    for (const Tile &tile: g.workspace.tiles) {
+        max_rate = std::max(max_rate, tile.max_rate);
+    }
+    if (g.amr.enabled) {
+        start = profiling ? Profiler::Clock::now() : start;
+        max_rate = std::max(max_rate, amr_step<RCT, LIM, RS, RK>(g, dt));
+        add_wall(g, PHASE_REFINEMENT, start);
+    }
+    start = profiling ? Profiler::Clock::now() : start;
+    g.SetTimeStep(max_rate);
+    add_wall(g, PHASE_TIME_STEP, start);
+}
+
+template<int RCT, int LIM, int RS>
+static StepFunction select_integrator(const int rkstages) {
+    return rkstages == 1 ? time_step<RCT, LIM, RS, 1> : time_step<RCT, LIM, RS, 2>;
+}
+
+template<int RCT, int LIM>
+static StepFunction select_solver(const int riemann_solver_type, const int rkstages) {
+    switch (riemann_solver_type) {
+        case HLLE:
+            return select_integrator<RCT, LIM, HLLE>(rkstages);
+        case HLLC:
+            return select_integrator<RCT, LIM, HLLC>(rkstages);
+        default:
+            return select_integrator<RCT, LIM, HLLC_SIMD>(rkstages);
+    }
+}
+
+StepFunction SelectStepFunction(const int reconstruct_type, const int limiter_type, const int riemann_solver_type,
+                                const int rkstages) {
+    if (reconstruct_type == CONSTANT) {
+        // The limiter only matters for linear reconstruction
+        return select_solver<CONSTANT, MINMOD>(riemann_solver_type, rkstages);
+    }
+    switch (limiter_type) {
+        case MC:
+            return select_solver<LINEAR, MC>(riemann_solver_type, rkstages);
+        case VANLEER:
+            return select_solver<LINEAR, VANLEER>(riemann_solver_type, rkstages);
+        default:
+            return select_solver<LINEAR, MINMOD>(riemann_solver_type, rkstages);
+    }
+}
+
+void UpdateTile(Grid &grid, const Tile &tile, const int stage) {
+    if (stage == 0) {
+        integrate<0>(grid.cons, grid.workspace.cons0, tile.i0, tile.j0, tile, grid.dt);
+    } else {
+        integrate<1>(grid.cons, grid.workspace.cons0, tile.i0, tile.j0, tile, grid.dt);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef APEP_HYDRO_PIPELINE_H
+#define APEP_HYDRO_PIPELINE_H
+
+struct Grid;
+struct Tile;
+
+// One full time step of a grid, specialized at compile time for a reconstruction, limiter,
+// Riemann solver and integrator
+using StepFunction = void (*)(Grid &grid);
+
+// Picks the pre-instantiated specialization matching the runtime settings. Called once when
+// the grid is reset, so the step itself has no type switches left.
+StepFunction SelectStepFunction(int reconstruct_type, int limiter_type, int riemann_solver_type, int rkstages);
+
+// Runge-Kutta update of stage 0 or 1 on the cells of a tile from its residual, the same code the
+// step runs. For timing the update on its own.
+void UpdateTile(Grid &grid, const Tile &tile, int stage);
+
+#endif //APEP_HYDRO_PIPELINE_H
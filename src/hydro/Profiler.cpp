@@ -0,0 +1,46 @@
+#include "Profiler.h"
+
+#include <algorithm>
+
+const char *PhaseName(const int phase) {
+    static const char *names[PHASE_COUNT] = {
+        "Halo fill", "Prim to cons", "X sweep", "Y sweep", "Source", "Update", "Cons to prim", "Time step",
+        "Refinement", "Image upload", "Heatmap draw",
+    };
+    return phase >= 0 && phase < PHASE_COUNT ? names[phase] : "";
+}
+
+std::vector<std::unique_ptr<PerfCounters>> Profiler::MakeCounters(const int nthreads) {
+    std::vector<std::unique_ptr<PerfCounters>> made;
+    for (int t = 0; t < nthreads; t++) {
+        made.push_back(std::make_unique<PerfCounters>());
+    }
+    return made;
+}
+
+void Profiler::Resize(const int nthreads) {
+    slots.assign(std::max(1, nthreads), Slot());
+    // The pool may have new threads, each opens its counters again
+    counters = MakeCounters(std::max(1, nthreads));
+    times = PhaseTimes();
+}
+
+PhaseTimes Profiler::Collect() {
+    PhaseTimes collected = times;
+    for (Slot &slot: slots) {
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            collected.seconds[p] += slot.seconds[p] / static_cast<double>(slots.size());
+            for (int c = 0; c < COUNTER_COUNT; c++) {
+                collected.counts[p][c] += slot.counts[p][c];
+            }
+        }
+        slot = Slot();
+    }
+    for (const std::unique_ptr<PerfCounters> &c: counters) {
+        for (int k = 0; k < COUNTER_COUNT; k++) {
+            collected.counted[k] |= c->Available(k);
+        }
+    }
+    times = PhaseTimes();
+    return collected;
+}
@@ -0,0 +1,148 @@
+#ifndef APEP_HYDRO_PROFILER_H
+#define APEP_HYDRO_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "PerfCounters.h"
+
+enum PhaseType {
+    // Phases of a time step
+    PHASE_HALO = 0, // Tile copies with the boundary conditions
+    PHASE_PRIM_TO_CONS = 1, // Conserved state at the start of the step
+    PHASE_SWEEP_X = 2,
+    PHASE_SWEEP_Y = 3,
+    PHASE_SOURCE = 4, // Gravity
+    PHASE_UPDATE = 5, // Runge-Kutta update
+    PHASE_CONS_TO_PRIM = 6,
+    PHASE_TIME_STEP = 7, // Signal rates and the next dt
+    PHASE_REFINEMENT = 8, // Regrid, patch steps and level synchronization
+    // Phases of a UI frame
+    PHASE_IMAGE_UPLOAD = 9,
+    PHASE_HEATMAP_DRAW = 10,
+    PHASE_COUNT,
+};
+
+static constexpr int STEP_PHASE_COUNT = PHASE_REFINEMENT + 1;
+
+const char *PhaseName(int phase);
+
+// Seconds per phase collected from a Profiler
+struct PhaseTimes {
+    double seconds[PHASE_COUNT] = {};
+    double step_seconds = 0.0; // Wall time of the steps
+    long steps = 0;
+    // Hardware counts per phase summed over the threads, while counting. Phases the calling
+    // thread runs alone are not counted.
+    double counts[PHASE_COUNT][COUNTER_COUNT] = {};
+    bool counted[COUNTER_COUNT] = {}; // Counters some thread could read
+};
+
+// Accumulates the time spent in each phase, per thread so the timers of a parallel loop never
+// share a cache line. Timers only read the clock while enabled, otherwise they cost one relaxed
+// load, so they can stay in the step for good.
+struct Profiler {
+    using Clock = std::chrono::steady_clock;
+
+    // May be switched from any thread
+    std::atomic<bool> enabled{false};
+    std::atomic<bool> counting{false}; // Hardware counters on top of the timers
+
+    bool Enabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // Drops the times so far
+    void Resize(int nthreads);
+
+    void Add(const int thread, const int phase, const double seconds) {
+        slots[thread].seconds[phase] += seconds;
+    }
+
+    // Counters of a thread, opened on first use so that they count the calling thread, which
+    // has to be the one running as thread. Null while not counting or without counters.
+    PerfCounters *Counters(const int thread) {
+        if (!counting.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        PerfCounters &c = *counters[thread];
+        if (!c.Tried()) {
+            c.Open();
+        }
+        return c.IsOpen() ? &c : nullptr;
+    }
+
+    void AddCounts(const int thread, const int phase, const double *start, const double *end) {
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            slots[thread].counts[phase][c] += end[c] - start[c];
+        }
+    }
+
+    // Time of a phase run by the calling thread while the others wait, counted as if every
+    // thread spent it
+    void AddWall(const int phase, const double seconds) {
+        slots[0].seconds[phase] += seconds * static_cast<double>(slots.size());
+    }
+
+    void AddStep(const double seconds) {
+        times.step_seconds += seconds;
+        times.steps++;
+    }
+
+    // Times since the last call, with the phases averaged over the threads so that with an even
+    // load they add up to the wall time. Not while the threads are running.
+    PhaseTimes Collect();
+
+private:
+    struct alignas(64) Slot {
+        double seconds[PHASE_COUNT] = {};
+        double counts[PHASE_COUNT][COUNTER_COUNT] = {};
+    };
+
+    std::vector<Slot> slots = std::vector<Slot>(1);
+    std::vector<std::unique_ptr<PerfCounters>> counters = MakeCounters(1); // One per thread
+
+    static std::vector<std::unique_ptr<PerfCounters>> MakeCounters(int nthreads);
+    PhaseTimes times;
+};
+
+// Adds the time, and the hardware counts while counting, from construction to destruction to a
+// phase of the profiler
+struct ScopedPhase {
+    ScopedPhase(Profiler &profiler, const int thread, const int phase)
+        : profiler(profiler.Enabled() ? &profiler : nullptr), thread(thread), phase(phase) {
+        if (this->profiler != nullptr) {
+            counters = this->profiler->Counters(thread);
+            if (counters != nullptr) {
+                counters->Read(start_counts);
+            }
+            start = Profiler::Clock::now();
+        }
+    }
+
+    ~ScopedPhase() {
+        if (profiler != nullptr) {
+            profiler->Add(thread, phase, std::chrono::duration<double>(Profiler::Clock::now() - start).count());
+            if (counters != nullptr) {
+                double end_counts[COUNTER_COUNT];
+                counters->Read(end_counts);
+                profiler->AddCounts(thread, phase, start_counts, end_counts);
+            }
+        }
+    }
+
+    ScopedPhase(const ScopedPhase &) = delete;
+
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+private:
+    Profiler *profiler;
+    PerfCounters *counters = nullptr;
+    int thread, phase;
+    Profiler::Clock::time_point start;
+    double start_counts[COUNTER_COUNT];
+};
+
+#endif //APEP_HYDRO_PROFILER_H
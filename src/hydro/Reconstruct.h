@@ -8,16 +8,29 @@ enum ReconstructType {
     LINEAR = 1,
 };
 
+enum SlopeLimiter {
+    MINMOD = 0,
+    MC = 1, // Monotonized central
+    VANLEER = 2,
+};
+
 enum ReconstructDirection {
     XDIR = 0,
     YDIR = 1,
 };
 
+// Cells around a run of interfaces for one variable. Interface k sits between m1[k] and c0[k],
+// with m2[k] and p1[k] the next cells outwards.
+struct Stencil {
+    const float *m2, *m1, *c0, *p1;
+};
+
 struct Reconstructor {
     const int nx, ny, nghost;
     const int rct;
+    const int limiter;
 
-    Reconstructor(int nx, int ny, int nghost, int rct);
+    Reconstructor(int nx, int ny, int nghost, int rct, int limiter = MINMOD);
 
     Reconstructor();
 
@@ -28,6 +41,10 @@ struct Reconstructor {
     void ReconstructConstant(const struct QVec &q, struct QVec &ql, struct QVec &qr, const int dir);
 
     void ReconstructLinear(const struct QVec &q, struct QVec &ql, struct QVec &qr, const int dir);
+
+    // Left and right states at n interfaces from one stencil per variable (rho, u, v, en).
+    // Both directions go through here, the pencil versions above only set up the stencils.
+    void ReconstructStencil(const Stencil (&s)[4], struct QVec &ql, struct QVec &qr, const int n);
 };
 
 
@@ -1,88 +1,94 @@
 #include "RiemannSolver.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
-#include <iostream>
 
+#include "Kernels.h"
 #include "Reconstruct.h"
 
-int sign(const float val) {
-    return std::signbit(val) ? -1 : 1;
-}
-
 RiemannSolver::RiemannSolver(int nx, int ny, int nghost, int rs) : nx(nx), ny(ny), nghost(nghost), rs(rs) {
 }
 
 void RiemannSolver::Solve(const struct QVec &ql, const struct QVec &qr, struct QVec &flux, const float gamma_ad,
                           const int dir) {
+    SolveInterfaces(ql, qr, flux, gamma_ad, dir == XDIR ? nx + 1 : ny + 1);
+}
+
+void RiemannSolver::SolveInterfaces(const struct QVec &ql, const struct QVec &qr, struct QVec &flux,
+                                    const float gamma_ad, const int n) {
     if (rs == HLLE) {
-        SolveHLLE(ql, qr, flux, gamma_ad, dir);
+        SolveHLLE(ql, qr, flux, gamma_ad, n);
     } else if (rs == HLLC) {
-        SolveHLLC(ql, qr, flux, gamma_ad, dir);
+        SolveHLLC(ql, qr, flux, gamma_ad, n);
+    } else if (rs == HLLC_SIMD) {
+        SolveHLLCSimd(ql, qr, flux, gamma_ad, n);
     }
 }
 
 void RiemannSolver::SolveHLLC(const struct QVec &ql, const struct QVec &qr, struct QVec &flux, const float gamma_ad,
-                              const int dir) {
+                              const int n) {
     // Solve HLLC
-    const int idx_max = dir == XDIR ? nx + 1 : ny + 1;
-    for (int i = 0; i < idx_max; i++) {
-        // Left states
-        const float rhol = ql.rho[i];
-        const float ul = ql.u[i];
-        const float vl = ql.v[i];
-        const float pl = ql.en[i];
-        const float vel2l = ul * ul + vl * vl;
-        const float el = pl / (gamma_ad - 1) + 0.5f * rhol * vel2l;
-
-        // Right states
-        const float rhor = qr.rho[i];
-        const float ur = qr.u[i];
-        const float vr = qr.v[i];
-        const float pr = qr.en[i];
-        const float vel2r = ur * ur + vr * vr;
-        const float er = pr / (gamma_ad - 1) + 0.5f * rhor * vel2r;
-
-        const float cl = gamma_ad * pl / rhol;
-        const float cr = gamma_ad * pr / rhor;
-
-        const float cmax = std::sqrt(std::max(cl, cr));
-
-        const float sl = std::min(ul, ur) - cmax;
-        const float sr = std::max(ul, ur) + cmax;
-
-        const float dsul = sl - ul;
-        const float dsur = sr - ur;
-
-        const float ustar = (pr - pl + rhol * ul * dsul - rhor * ur * dsur) / (rhol * dsul - rhor * dsur);
-
-        const float rhobar = 0.5 * (rhol + rhor);
-        const float cbar = std::sqrt(0.5 * (cl + cr));
-
-        const float pstar = 0.5 * (pl + pr) - 0.5 * rhobar * cbar * (ur - ul);
-
-        const int sgn = sign(ustar);
-
-        const float rhostarl = rhol * (dsul / (sl - ustar));
-        const float estarl = rhostarl * (el / rhol + (ustar - ul) * (ustar + pl / rhol / dsul));
-
-        const float rhostarr = rhor * (dsur / (sr - ustar));
-        const float estarr = rhostarr * (er / rhor + (ustar - ur) * (ustar + pr / rhor / dsur));
-
-        const float onemsignh = 0.5 * (1.0 - sgn);
-        const float onepsignh = 0.5 * (1.0 + sgn);
-
-        const float rhostar = onepsignh * rhostarl + onemsignh * rhostarr;
-        const float rhoustar = rhostar * ustar;
+    for (int i = 0; i < n; i++) {
+        float speed;
+        store_lanes(flux, i, hllc_reference(load_lanes<float>(ql, i), load_lanes<float>(qr, i), gamma_ad, speed));
+    }
+}
 
-        // Calculate fluxes
-        flux.rho[i] = rhoustar;
-        flux.u[i] = rhoustar * ustar + pstar;
-        flux.v[i] = rhoustar * (onepsignh * vl + onemsignh * vr);
-        flux.en[i] = (onepsignh * estarl + onemsignh * estarr + pstar) * ustar;
+void RiemannSolver::SolveHLLCSimd(const struct QVec &ql, const struct QVec &qr, struct QVec &flux,
+                                  const float gamma_ad, const int n) {
+    int i = 0;
+    for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH) {
+        VFloat speed;
+        store_lanes(flux, i, hllc_lanes(load_lanes<VFloat>(ql, i), load_lanes<VFloat>(qr, i), gamma_ad, speed));
+    }
+    // Scalar tail
+    for (; i < n; i++) {
+        float speed;
+        store_lanes(flux, i, hllc_lanes(load_lanes<float>(ql, i), load_lanes<float>(qr, i), gamma_ad, speed));
     }
 }
 
 void RiemannSolver::SolveHLLE(const struct QVec &ql, const struct QVec &qr, struct QVec &flux, const float gamma_ad,
-                              const int dir) {
-    // Solve HLLE
+                              const int n) {
+    int i = 0;
+    for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH) {
+        VFloat speed;
+        store_lanes(flux, i, hlle_lanes(load_lanes<VFloat>(ql, i), load_lanes<VFloat>(qr, i), gamma_ad, speed));
+    }
+    // Scalar tail
+    for (; i < n; i++) {
+        float speed;
+        store_lanes(flux, i, hlle_lanes(load_lanes<float>(ql, i), load_lanes<float>(qr, i), gamma_ad, speed));
+    }
+}
+
+double MeasureSolveCost(const int rs, const int n, const float gamma_ad) {
+    // Smoothly varying states with both signs of the contact speed, like a perturbed RT layer
+    QVec ql(n), qr(n), flux(n);
+    for (int i = 0; i < n; i++) {
+        const float x = 0.01f * i;
+        ql.rho[i] = 1.5f + 0.5f * std::sin(x);
+        ql.u[i] = 0.1f * std::cos(3.0f * x);
+        ql.v[i] = 0.05f * std::sin(2.0f * x);
+        ql.en[i] = 2.5f - 0.1f * std::sin(x);
+        qr.rho[i] = 1.5f + 0.5f * std::sin(x + 0.01f);
+        qr.u[i] = 0.1f * std::cos(3.0f * x + 0.03f);
+        qr.v[i] = 0.05f * std::sin(2.0f * x + 0.02f);
+        qr.en[i] = 2.5f - 0.1f * std::sin(x + 0.01f);
+    }
+
+    RiemannSolver solver(n - 1, n - 1, 0, rs);
+    constexpr int batches = 5;
+    constexpr int repeats = 50;
+    double best = 1.0e30;
+    for (int b = 0; b < batches; b++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            solver.SolveInterfaces(ql, qr, flux, gamma_ad, n);
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(stop - start).count());
+    }
+    return best / (static_cast<double>(repeats) * n);
 }
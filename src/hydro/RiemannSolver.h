@@ -4,8 +4,9 @@
 #include "Hydro.h"
 
 enum RiemannSolverType {
-    HLLE = 0,
+    HLLE = 0, // Vectorized HLLE
     HLLC = 1,
+    HLLC_SIMD = 2, // Vectorized HLLC, matches HLLC to ~1e-6 relative (float rounding only)
 };
 
 struct RiemannSolver {
@@ -20,11 +21,27 @@ struct RiemannSolver {
 
     void Solve(const struct QVec &ql, const struct QVec &qr, struct QVec &flux, const float gamma_ad, const int dir);
 
+    // Fluxes at the first n interfaces. The u slot of the states is the velocity normal to the
+    // interface, so a y-sweep passes v there and reads the normal momentum flux back from u.
+    void SolveInterfaces(const struct QVec &ql, const struct QVec &qr, struct QVec &flux, const float gamma_ad,
+                         const int n);
+
     void SolveHLLC(const struct QVec &ql, const struct QVec &qr, struct QVec &flux, const float gamma_ad,
-                   const int dir);
+                   const int n);
+
+    // Same fluxes as SolveHLLC, computed SIMD_WIDTH interfaces at a time with the upwind
+    // star state picked by a lane mask. The scalar version evaluates some terms in double,
+    // so the two agree to float rounding, about 1e-6 relative.
+    void SolveHLLCSimd(const struct QVec &ql, const struct QVec &qr, struct QVec &flux, const float gamma_ad,
+                       const int n);
 
+    // HLLE with Einfeldt wave speeds, vectorized like SolveHLLCSimd. Cheaper but more diffusive.
     void SolveHLLE(const struct QVec &ql, const struct QVec &qr, struct QVec &flux, const float gamma_ad,
-                   const int dir);
+                   const int n);
 };
 
+// Wall time of solver rs in nanoseconds per interface, best of several batches over a
+// synthetic pencil of n interfaces
+double MeasureSolveCost(int rs, int n = 4096, float gamma_ad = 1.4f);
+
 #endif //APEP_HYDRO_RIEMANN_H
@@ -0,0 +1,166 @@
+#ifndef APEP_HYDRO_SIMD_H
+#define APEP_HYDRO_SIMD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Thin wrapper around the widest float vector the target supports (see -march in CMakeLists.txt).
+// Kernels are written once as templates over the lane type and instantiated for VFloat in the
+// main loop and for plain float in the scalar tail, so both paths share the same arithmetic.
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+static constexpr int SIMD_WIDTH = 16;
+
+struct VFloat {
+    __m512 v;
+};
+
+struct VMask {
+    __mmask16 m;
+};
+
+inline VFloat simd_load(const float *p) { return {_mm512_loadu_ps(p)}; }
+inline void simd_store(float *p, const VFloat a) { _mm512_storeu_ps(p, a.v); }
+inline VFloat simd_set1(const float a) { return {_mm512_set1_ps(a)}; }
+inline VFloat operator+(const VFloat a, const VFloat b) { return {_mm512_add_ps(a.v, b.v)}; }
+inline VFloat operator-(const VFloat a, const VFloat b) { return {_mm512_sub_ps(a.v, b.v)}; }
+inline VFloat operator*(const VFloat a, const VFloat b) { return {_mm512_mul_ps(a.v, b.v)}; }
+inline VFloat operator/(const VFloat a, const VFloat b) { return {_mm512_div_ps(a.v, b.v)}; }
+inline VFloat simd_sqrt(const VFloat a) { return {_mm512_sqrt_ps(a.v)}; }
+inline VFloat simd_min(const VFloat a, const VFloat b) { return {_mm512_min_ps(a.v, b.v)}; }
+inline VFloat simd_max(const VFloat a, const VFloat b) { return {_mm512_max_ps(a.v, b.v)}; }
+inline VFloat simd_abs(const VFloat a) { return {_mm512_abs_ps(a.v)}; }
+inline VMask operator<(const VFloat a, const VFloat b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)}; }
+inline VMask operator>(const VFloat a, const VFloat b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)}; }
+inline VMask operator>=(const VFloat a, const VFloat b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)}; }
+inline VMask operator&(const VMask a, const VMask b) { return {static_cast<__mmask16>(a.m & b.m)}; }
+inline VMask operator|(const VMask a, const VMask b) { return {static_cast<__mmask16>(a.m | b.m)}; }
+// Lane-wise mask ? a : b
+inline VFloat simd_select(const VMask mask, const VFloat a, const VFloat b) {
+    return {_mm512_mask_blend_ps(mask.m, b.v, a.v)};
+}
+inline float simd_hmax(const VFloat a) { return _mm512_reduce_max_ps(a.v); }
+inline float simd_hsum(const VFloat a) { return _mm512_reduce_add_ps(a.v); }
+// Lanes truncated to integers
+inline void simd_store_int(int32_t *p, const VFloat a) { _mm512_storeu_si512(p, _mm512_cvttps_epi32(a.v)); }
+
+#elif defined(__AVX2__)
+#include <immintrin.h>
+
+static constexpr int SIMD_WIDTH = 8;
+
+struct VFloat {
+    __m256 v;
+};
+
+struct VMask {
+    __m256 m;
+};
+
+inline VFloat simd_load(const float *p) { return {_mm256_loadu_ps(p)}; }
+inline void simd_store(float *p, const VFloat a) { _mm256_storeu_ps(p, a.v); }
+inline VFloat simd_set1(const float a) { return {_mm256_set1_ps(a)}; }
+inline VFloat operator+(const VFloat a, const VFloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline VFloat operator-(const VFloat a, const VFloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline VFloat operator*(const VFloat a, const VFloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline VFloat operator/(const VFloat a, const VFloat b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline VFloat simd_sqrt(const VFloat a) { return {_mm256_sqrt_ps(a.v)}; }
+inline VFloat simd_min(const VFloat a, const VFloat b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline VFloat simd_max(const VFloat a, const VFloat b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline VFloat simd_abs(const VFloat a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+inline VMask operator<(const VFloat a, const VFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline VMask operator>(const VFloat a, const VFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+inline VMask operator>=(const VFloat a, const VFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+inline VMask operator&(const VMask a, const VMask b) { return {_mm256_and_ps(a.m, b.m)}; }
+inline VMask operator|(const VMask a, const VMask b) { return {_mm256_or_ps(a.m, b.m)}; }
+// Lane-wise mask ? a : b
+inline VFloat simd_select(const VMask mask, const VFloat a, const VFloat b) {
+    return {_mm256_blendv_ps(b.v, a.v, mask.m)};
+}
+inline float simd_hmax(const VFloat a) {
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_movehdup_ps(m));
+    return _mm_cvtss_f32(m);
+}
+inline float simd_hsum(const VFloat a) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+// Lanes truncated to integers
+inline void simd_store_int(int32_t *p, const VFloat a) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm256_cvttps_epi32(a.v));
+}
+
+#else
+
+// No vector extension available, fall back to one lane
+static constexpr int SIMD_WIDTH = 1;
+
+struct VFloat {
+    float v;
+};
+
+struct VMask {
+    bool m;
+};
+
+inline VFloat simd_load(const float *p) { return {*p}; }
+inline void simd_store(float *p, const VFloat a) { *p = a.v; }
+inline VFloat simd_set1(const float a) { return {a}; }
+inline VFloat operator+(const VFloat a, const VFloat b) { return {a.v + b.v}; }
+inline VFloat operator-(const VFloat a, const VFloat b) { return {a.v - b.v}; }
+inline VFloat operator*(const VFloat a, const VFloat b) { return {a.v * b.v}; }
+inline VFloat operator/(const VFloat a, const VFloat b) { return {a.v / b.v}; }
+inline VFloat simd_sqrt(const VFloat a) { return {std::sqrt(a.v)}; }
+inline VFloat simd_min(const VFloat a, const VFloat b) { return {std::min(a.v, b.v)}; }
+inline VFloat simd_max(const VFloat a, const VFloat b) { return {std::max(a.v, b.v)}; }
+inline VFloat simd_abs(const VFloat a) { return {std::abs(a.v)}; }
+inline VMask operator<(const VFloat a, const VFloat b) { return {a.v < b.v}; }
+inline VMask operator>(const VFloat a, const VFloat b) { return {a.v > b.v}; }
+inline VMask operator>=(const VFloat a, const VFloat b) { return {a.v >= b.v}; }
+inline VMask operator&(const VMask a, const VMask b) { return {a.m && b.m}; }
+inline VMask operator|(const VMask a, const VMask b) { return {a.m || b.m}; }
+inline VFloat simd_select(const VMask mask, const VFloat a, const VFloat b) { return mask.m ? a : b; }
+inline float simd_hmax(const VFloat a) { return a.v; }
+inline float simd_hsum(const VFloat a) { return a.v; }
+inline void simd_store_int(int32_t *p, const VFloat a) { *p = static_cast<int32_t>(a.v); }
+
+#endif
+
+// Scalar overloads, used for the remainder lanes of every kernel
+inline float simd_sqrt(const float a) { return std::sqrt(a); }
+inline float simd_min(const float a, const float b) { return std::min(a, b); }
+inline float simd_max(const float a, const float b) { return std::max(a, b); }
+inline float simd_abs(const float a) { return std::abs(a); }
+inline float simd_select(const bool mask, const float a, const float b) { return mask ? a : b; }
+inline void simd_store_int(int32_t *p, const float a) { *p = static_cast<int32_t>(a); }
+
+// Lane type helpers so kernels can be written once for VFloat and float
+template<typename T>
+struct Lanes;
+
+template<>
+struct Lanes<VFloat> {
+    using Mask = VMask;
+    static constexpr int width = SIMD_WIDTH;
+    static VFloat Load(const float *p) { return simd_load(p); }
+    static void Store(float *p, const VFloat a) { simd_store(p, a); }
+    static VFloat Set1(const float a) { return simd_set1(a); }
+};
+
+template<>
+struct Lanes<float> {
+    using Mask = bool;
+    static constexpr int width = 1;
+    static float Load(const float *p) { return *p; }
+    static void Store(float *p, const float a) { *p = a; }
+    static float Set1(const float a) { return a; }
+};
+
+#endif //APEP_HYDRO_SIMD_H
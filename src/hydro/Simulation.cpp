@@ -0,0 +1,107 @@
+#include "Simulation.h"
+
+#include <chrono>
+
+#include "Trace.h"
+
+// Shortest time between two snapshots while running, about two per displayed frame
+static constexpr std::chrono::milliseconds PUBLISH_INTERVAL(8);
+
+Simulation::Simulation(RTSettings &settings) : grid(settings), settings(settings) {
+    playing = settings.playing;
+    Publish();
+    thread = std::thread(&Simulation::Loop, this);
+}
+
+Simulation::~Simulation() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+unsigned Simulation::Send(const CommandType type, const RTSettings &settings) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({type, settings, ++sent});
+    }
+    wake.notify_one();
+    return sent;
+}
+
+void Simulation::Loop() {
+    TraceThreadName("Simulation");
+    std::vector<Command> commands;
+    auto last_publish = std::chrono::steady_clock::now();
+    while (true) {
+        const auto running = [this] { return playing && grid.time < settings.tmax; };
+        {
+            // Sleep until there is something to do
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || !queue.empty() || running() || advance > 0; });
+            if (stopping) {
+                return;
+            }
+            commands.swap(queue);
+        }
+        bool changed = !commands.empty();
+        for (Command &command: commands) {
+            Apply(command);
+        }
+        commands.clear();
+
+        if (running()) {
+            grid.TimeStep(settings.tmax);
+            if (grid.time >= settings.tmax) {
+                playing = false;
+                changed = true;
+            }
+        } else if (advance > 0) {
+            grid.TimeStep();
+            advance--;
+            changed = true;
+        }
+
+        // Publish every state change right away, running steps only as often as anyone can see them
+        const auto now = std::chrono::steady_clock::now();
+        if (changed || now - last_publish >= PUBLISH_INTERVAL) {
+            Publish();
+            last_publish = now;
+        }
+    }
+}
+
+void Simulation::Apply(Command &command) {
+    settings = command.settings;
+    applied = command.serial;
+    switch (command.type) {
+        case RESET:
+            grid.Clear();
+            grid.Reset(command.settings);
+            break;
+        case PLAY:
+            playing = true;
+            break;
+        case PAUSE:
+            playing = false;
+            break;
+        case ADVANCE:
+            if (!playing) {
+                advance++;
+            }
+            break;
+    }
+}
+
+void Simulation::Publish() {
+    APEP_TRACE_SCOPE("Publish");
+    Snapshot &snapshot = snapshots.Back();
+    grid.Capture(snapshot);
+    snapshot.diagnostics = diagnostics.Reduce(grid);
+    snapshot.phases = grid.profiler.Collect();
+    snapshot.playing = playing;
+    snapshot.serial = applied;
+    snapshots.Publish();
+}
@@ -0,0 +1,93 @@
+#ifndef APEP_HYDRO_SIMULATION_H
+#define APEP_HYDRO_SIMULATION_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Diagnostics.h"
+#include "Grid.h"
+#include "Settings.h"
+#include "Snapshot.h"
+
+enum CommandType {
+    RESET = 0, // Rebuild the grid from the settings of the command
+    PLAY = 1,
+    PAUSE = 2,
+    ADVANCE = 3, // One step while paused
+};
+
+// Request from the UI to the simulation thread. Every command carries the current settings, so
+// values that apply without a reset (such as tmax) follow the UI.
+struct Command {
+    CommandType type;
+    RTSettings settings;
+    unsigned serial = 0;
+};
+
+// Runs a grid on its own thread as fast as it can step. The UI talks to it through commands and
+// reads the state back from snapshots the thread publishes, so neither waits for the other.
+struct Simulation {
+    explicit Simulation(RTSettings &settings);
+
+    ~Simulation();
+
+    Simulation(const Simulation &) = delete;
+
+    Simulation &operator=(const Simulation &) = delete;
+
+    // Queues a command for the simulation thread and returns its serial number
+    unsigned Send(CommandType type, const RTSettings &settings);
+
+    // Picks up the newest snapshot, true if there was a new one since the last call
+    bool Acquire() {
+        return snapshots.Acquire();
+    }
+
+    // Snapshot taken by the last Acquire, valid until the next one
+    const Snapshot &Latest() const {
+        return snapshots.Front();
+    }
+
+    // Switches the phase timers of the steps on or off, their times go with the snapshots
+    void Profile(const bool enabled) {
+        grid.profiler.enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    // Adds the hardware counters to the phase timers, where the system offers them
+    void Count(const bool enabled) {
+        grid.profiler.counting.store(enabled, std::memory_order_relaxed);
+    }
+
+    // Whether the simulation thread had applied every command sent when snapshot was taken
+    bool Synced(const Snapshot &snapshot) const {
+        return snapshot.serial == sent;
+    }
+
+private:
+    void Loop();
+
+    void Apply(Command &command);
+
+    void Publish();
+
+    Grid grid;
+    RTSettings settings; // Settings of the last command, owned by the simulation thread
+    bool playing = false;
+    int advance = 0; // Steps requested while paused
+    unsigned applied = 0; // Serial of the last applied command
+    TripleBuffer<Snapshot> snapshots;
+    DiagnosticsReducer diagnostics;
+
+    // Command queue, the only state shared under a lock
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Command> queue;
+    bool stopping = false;
+    unsigned sent = 0; // Serial of the last command sent, UI thread only
+
+    std::thread thread;
+};
+
+#endif //APEP_HYDRO_SIMULATION_H
@@ -0,0 +1,115 @@
+#include "Snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "SnapshotFile.h"
+
+// First multiple of SNAPSHOT_ALIGN at or after offset
+static uint64_t align_offset(const uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+bool Snapshot::Write(const std::string &filename) const {
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(SnapshotHeader);
+    header.nx = nx;
+    header.ny = ny;
+    header.stride = rho.stride;
+    header.nfields = SNAPSHOT_FIELDS;
+    header.field_bytes = rho.Size() * sizeof(float);
+    uint64_t offset = sizeof(SnapshotHeader);
+    for (int k = 0; k < SNAPSHOT_FIELDS; k++) {
+        header.field_offset[k] = align_offset(offset);
+        offset = header.field_offset[k] + header.field_bytes;
+    }
+    header.file_size = offset;
+    header.step = step;
+    header.time = time;
+    header.dt = dt;
+    header.x1 = x1;
+    header.x2 = x2;
+    header.y1 = y1;
+    header.y2 = y2;
+    header.dlx = dlx;
+    header.dly = dly;
+    header.gamma_ad = gamma_ad;
+    header.cfl = cfl;
+    header.grav_x = grav_x;
+    header.grav_y = grav_y;
+    header.refinement = refinement;
+    header.reconstruct_type = reconstruct_type;
+    header.limiter_type = limiter_type;
+    header.riemann_solver_type = riemann_solver_type;
+    header.rkstages = rkstages;
+    header.dt_type = dt_type;
+    header.amr_block = amr_block;
+    header.amr_patches = amr_patches;
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file %s\n", filename.c_str());
+        return false;
+    }
+    // Blocks go out in one call each, the zeros only pad up to the next page
+    static const char zeros[SNAPSHOT_ALIGN] = {};
+    const Field2D *fields[SNAPSHOT_FIELDS] = {&rho, &u, &v, &en};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t written = sizeof(header);
+    for (int k = 0; ok && k < SNAPSHOT_FIELDS; k++) {
+        const size_t padding = header.field_offset[k] - written;
+        ok = fwrite(zeros, 1, padding, file) == padding
+             && fwrite(fields[k]->data, 1, header.field_bytes, file) == header.field_bytes;
+        written = header.field_offset[k] + header.field_bytes;
+    }
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Error writing file %s\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Snapshot::Read(const std::string &filename) {
+    SnapshotFile file;
+    if (!file.Open(filename)) {
+        return false;
+    }
+    const SnapshotHeader &header = *file.header;
+    *this = Snapshot();
+    nx = header.nx;
+    ny = header.ny;
+    step = header.step;
+    time = header.time;
+    dt = header.dt;
+    x1 = header.x1;
+    x2 = header.x2;
+    y1 = header.y1;
+    y2 = header.y2;
+    dlx = header.dlx;
+    dly = header.dly;
+    gamma_ad = header.gamma_ad;
+    cfl = header.cfl;
+    grav_x = header.grav_x;
+    grav_y = header.grav_y;
+    refinement = header.refinement;
+    reconstruct_type = header.reconstruct_type;
+    limiter_type = header.limiter_type;
+    riemann_solver_type = header.riemann_solver_type;
+    rkstages = header.rkstages;
+    dt_type = header.dt_type;
+    amr_block = header.amr_block;
+    amr_patches = header.amr_patches;
+
+    const FieldView *views[SNAPSHOT_FIELDS] = {&file.rho, &file.u, &file.v, &file.en};
+    Field2D *fields[SNAPSHOT_FIELDS] = {&rho, &u, &v, &en};
+    for (int k = 0; k < SNAPSHOT_FIELDS; k++) {
+        fields[k]->Resize(nx, ny);
+        for (int j = 0; j < ny; j++) {
+            std::memcpy(fields[k]->Row(j), views[k]->Row(j), nx * sizeof(float));
+        }
+    }
+    return true;
+}
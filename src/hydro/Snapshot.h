@@ -0,0 +1,88 @@
+#ifndef APEP_HYDRO_SNAPSHOT_H
+#define APEP_HYDRO_SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+#include "Diagnostics.h"
+#include "Field.h"
+#include "Profiler.h"
+
+// Copy of a grid state that can be read while the grid keeps stepping. Fields hold only the
+// interior cells, nx * ny over the whole grid.
+struct Snapshot {
+    int nx = 0, ny = 0;
+    Field2D rho, u, v, en;
+    float time = 0.0f, dt = 0.0f;
+    float x1 = 0.0f, x2 = 0.0f, y1 = 0.0f, y2 = 0.0f;
+    float dlx = 0.0f, dly = 0.0f;
+    float gamma_ad = 0.0f;
+    float cfl = 0.0f;
+    float grav_x = 0.0f, grav_y = 0.0f;
+    long step = 0; // Time steps since the last reset
+    int reconstruct_type = 0;
+    int limiter_type = 0;
+    int riemann_solver_type = 0;
+    int rkstages = 0;
+    int dt_type = 0;
+    int nthreads = 0;
+    int ntiles = 0, tile_nx = 0, tile_ny = 0;
+    size_t step_allocations = 0;
+    int refinement = 1; // Resolution of the fields relative to the base grid
+    int amr_patches = 0, amr_block = 0; // Refined blocks and their size in base grid cells
+    bool playing = false; // Whether the simulation was running when this was taken
+    unsigned serial = 0; // Last command applied before this was taken
+    Diagnostics diagnostics; // Only filled in by the simulation thread
+    // Phase timers of the steps since the previous snapshot, while the simulation profiles
+    PhaseTimes phases;
+
+    // Writes the primitive variables and the header as a binary snapshot file, see
+    // SnapshotFile.h. Returns false and reports on stderr when the file cannot be written.
+    bool Write(const std::string &filename) const;
+
+    // Loads a snapshot file written by Write, for viewing saved runs. What the file does not
+    // hold, such as the diagnostics and the thread layout, is left zero. Returns false and
+    // reports on stderr when the file cannot be read.
+    bool Read(const std::string &filename);
+};
+
+// Lock-free handoff of the latest value from one producer thread to one consumer thread. The
+// producer fills Back() and publishes it, the consumer picks up the newest published buffer
+// with Acquire() and reads it through Front() until the next Acquire(). Neither side ever waits,
+// the producer simply overwrites a published buffer the consumer has not picked up yet.
+template<typename T>
+struct TripleBuffer {
+    // Producer side
+    T &Back() {
+        return buffers[back];
+    }
+
+    void Publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side, true if a newer buffer was published since the last call
+    bool Acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T &Front() const {
+        return buffers[front];
+    }
+
+private:
+    static constexpr int INDEX = 3;
+    static constexpr int FRESH = 4; // Set while the middle buffer has not been acquired yet
+
+    T buffers[3];
+    int back = 0;
+    std::atomic<int> middle{1};
+    int front = 2;
+};
+
+#endif //APEP_HYDRO_SNAPSHOT_H
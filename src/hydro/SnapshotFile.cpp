@@ -0,0 +1,82 @@
+#include "SnapshotFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string SnapshotFilename(const std::string &pattern, const long step) {
+    char digits[24];
+    std::snprintf(digits, sizeof(digits), "%06ld", step);
+    std::string filename = pattern;
+    for (size_t pos = filename.find("{step}"); pos != std::string::npos; pos = filename.find("{step}", pos)) {
+        filename.replace(pos, 6, digits);
+    }
+    return filename;
+}
+
+SnapshotFile::~SnapshotFile() {
+    Close();
+}
+
+bool SnapshotFile::Open(const std::string &filename) {
+    Close();
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening file %s\n", filename.c_str());
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SnapshotHeader)) {
+        fprintf(stderr, "Not a snapshot file: %s\n", filename.c_str());
+        close(fd);
+        return false;
+    }
+    mapping_size = info.st_size;
+    mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Error mapping file %s\n", filename.c_str());
+        mapping = nullptr;
+        return false;
+    }
+
+    // Everything the views rely on must fit in the file
+    const auto *h = static_cast<const SnapshotHeader *>(mapping);
+    bool valid = std::memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0
+                 && h->version == SNAPSHOT_VERSION && h->header_size == sizeof(SnapshotHeader)
+                 && h->nfields == SNAPSHOT_FIELDS && h->nx > 0 && h->ny > 0 && h->stride >= h->nx
+                 && h->field_bytes >= static_cast<uint64_t>(h->stride) * h->ny * sizeof(float)
+                 && h->file_size == mapping_size;
+    for (int k = 0; valid && k < SNAPSHOT_FIELDS; k++) {
+        valid = h->field_offset[k] % SNAPSHOT_ALIGN == 0 && h->field_offset[k] >= sizeof(SnapshotHeader)
+                && h->field_offset[k] <= mapping_size && h->field_bytes <= mapping_size - h->field_offset[k];
+    }
+    if (!valid) {
+        fprintf(stderr, "Not a version %u snapshot file: %s\n", SNAPSHOT_VERSION, filename.c_str());
+        Close();
+        return false;
+    }
+
+    header = h;
+    FieldView *fields[SNAPSHOT_FIELDS] = {&rho, &u, &v, &en};
+    for (int k = 0; k < SNAPSHOT_FIELDS; k++) {
+        fields[k]->nx = h->nx;
+        fields[k]->ny = h->ny;
+        fields[k]->stride = h->stride;
+        fields[k]->data = reinterpret_cast<const float *>(static_cast<const char *>(mapping) + h->field_offset[k]);
+    }
+    return true;
+}
+
+void SnapshotFile::Close() {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+    }
+    mapping = nullptr;
+    mapping_size = 0;
+    header = nullptr;
+    rho = u = v = en = FieldView();
+}
@@ -0,0 +1,90 @@
+#ifndef APEP_HYDRO_SNAPSHOTFILE_H
+#define APEP_HYDRO_SNAPSHOTFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary snapshot files. A file is one SnapshotHeader followed by the rho, u, v and en blocks,
+// each starting on a SNAPSHOT_ALIGN boundary. A block holds ny rows of stride little-endian
+// floats with row 0 at the bottom, the same layout as a Field2D, so a block can be written with
+// one call and read in place without copying.
+
+static constexpr char SNAPSHOT_MAGIC[8] = {'A', 'P', 'E', 'P', 'S', 'N', 'A', 'P'};
+static constexpr uint32_t SNAPSHOT_VERSION = 1;
+static constexpr uint64_t SNAPSHOT_ALIGN = 4096; // A page, so mapped blocks are page aligned
+static constexpr int SNAPSHOT_FIELDS = 4;
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "snapshot files are written in host byte order");
+
+// Fixed layout, only ever extended at the end with a new version
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size; // sizeof(SnapshotHeader) of the writer
+    // Layout
+    int32_t nx, ny;
+    int32_t stride; // Floats per row in the field blocks, nx rounded up to a cache line
+    int32_t nfields;
+    uint64_t field_offset[SNAPSHOT_FIELDS]; // Bytes from the start of the file
+    uint64_t field_bytes; // Bytes of one block, stride * ny * 4
+    uint64_t file_size;
+    // State
+    int64_t step;
+    float time, dt;
+    // Settings
+    float x1, x2, y1, y2;
+    float dlx, dly; // Cell size of the fields
+    float gamma_ad, cfl;
+    float grav_x, grav_y;
+    int32_t refinement; // Resolution of the fields relative to the base grid
+    int32_t reconstruct_type, limiter_type, riemann_solver_type;
+    int32_t rkstages, dt_type;
+    int32_t amr_block, amr_patches;
+};
+
+// File name for a step, with every {step} in pattern replaced by the step number padded to
+// 6 digits so the files sort in order
+std::string SnapshotFilename(const std::string &pattern, long step);
+
+// Read-only view of one field block
+struct FieldView {
+    int nx = 0, ny = 0;
+    int stride = 0;
+    const float *data = nullptr;
+
+    const float &operator()(const int i, const int j) const {
+        return data[static_cast<size_t>(j) * stride + i];
+    }
+
+    const float *Row(const int j) const {
+        return data + static_cast<size_t>(j) * stride;
+    }
+};
+
+// Snapshot file mapped into memory. The fields point into the mapping and stay valid until
+// Close, pages are only read from disk when touched.
+struct SnapshotFile {
+    const SnapshotHeader *header = nullptr;
+    FieldView rho, u, v, en;
+
+    SnapshotFile() = default;
+
+    SnapshotFile(const SnapshotFile &) = delete;
+
+    SnapshotFile &operator=(const SnapshotFile &) = delete;
+
+    ~SnapshotFile();
+
+    // Maps filename and checks its header and layout. Returns false and reports on stderr when
+    // the file cannot be read or is not a snapshot of this version.
+    bool Open(const std::string &filename);
+
+    void Close();
+
+private:
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+};
+
+#endif //APEP_HYDRO_SNAPSHOTFILE_H
@@ -0,0 +1,114 @@
+#include "SnapshotWriter.h"
+
+#include <algorithm>
+
+#include "Trace.h"
+
+// Largest decimation factor, one output kept out of this many
+static constexpr int MAX_DECIMATION = 1024;
+
+SnapshotWriter::SnapshotWriter(const int nbuffers, const int backpressure)
+    : backpressure(backpressure), buffers(std::max(nbuffers, 1)) {
+    for (Snapshot &buffer: buffers) {
+        free_buffers.push_back(&buffer);
+    }
+    queue.reserve(buffers.size());
+    thread = std::thread(&SnapshotWriter::Loop, this);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+Snapshot *SnapshotWriter::Acquire(const bool required) {
+    std::unique_lock<std::mutex> lock(mutex);
+    outputs++;
+    if (backpressure == BACKPRESSURE_DECIMATE) {
+        // Relax the decimation once everything queued so far has been written
+        if (queue.empty() && !writing && !free_buffers.empty()) {
+            stats.decimation = std::max(stats.decimation / 2, 1);
+        }
+        if (outputs % stats.decimation != 0 && !required) {
+            stats.dropped++;
+            return nullptr;
+        }
+    }
+    if (free_buffers.empty()) {
+        if (backpressure != BACKPRESSURE_BLOCK && !required) {
+            stats.dropped++;
+            if (backpressure == BACKPRESSURE_DECIMATE) {
+                stats.decimation = std::min(stats.decimation * 2, MAX_DECIMATION);
+            }
+            return nullptr;
+        }
+        const Clock::time_point start = Clock::now();
+        freed.wait(lock, [this] { return !free_buffers.empty(); });
+        stats.blocked_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    Snapshot *buffer = free_buffers.back();
+    free_buffers.pop_back();
+    return buffer;
+}
+
+void SnapshotWriter::Submit(Snapshot *buffer, WriteFunction write) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({buffer, std::move(write), Clock::now()});
+        stats.queue_depth++;
+        stats.max_queue_depth = std::max(stats.max_queue_depth, stats.queue_depth);
+    }
+    wake.notify_one();
+}
+
+void SnapshotWriter::Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    freed.wait(lock, [this] { return queue.empty() && !writing; });
+}
+
+WriterStats SnapshotWriter::Stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void SnapshotWriter::Loop() {
+    TraceThreadName("Snapshot writer");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        // Stopping only once the queue is drained
+        if (queue.empty()) {
+            return;
+        }
+        Job job = std::move(queue.front());
+        queue.erase(queue.begin());
+        writing = true;
+        lock.unlock();
+
+        const Clock::time_point start = Clock::now();
+        bool ok;
+        {
+            APEP_TRACE_SCOPE_ARG("Write", job.buffer->step);
+            ok = job.write(*job.buffer);
+        }
+        const Clock::time_point end = Clock::now();
+        job.write = nullptr;
+
+        lock.lock();
+        writing = false;
+        const double latency = std::chrono::duration<double>(end - job.submitted).count();
+        stats.written += ok;
+        stats.failed += !ok;
+        stats.queue_depth--;
+        stats.last_latency = latency;
+        stats.max_latency = std::max(stats.max_latency, latency);
+        stats.total_latency += latency;
+        stats.write_seconds += std::chrono::duration<double>(end - start).count();
+        free_buffers.push_back(job.buffer);
+        freed.notify_all();
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef APEP_HYDRO_SNAPSHOTWRITER_H
+#define APEP_HYDRO_SNAPSHOTWRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Snapshot.h"
+
+// What Acquire does when every buffer is still queued for the writer
+enum BackpressureType {
+    BACKPRESSURE_BLOCK = 0, // Wait for the writer to free a buffer
+    BACKPRESSURE_DROP = 1, // Skip this output
+    BACKPRESSURE_DECIMATE = 2, // Skip it and keep only every 2nd, 4th, ... output until the writer catches up
+};
+
+struct WriterStats {
+    long written = 0;
+    long failed = 0; // Writes that returned false
+    long dropped = 0; // Outputs skipped by the backpressure policy
+    int queue_depth = 0; // Buffers submitted and not yet written, including the one being written
+    int max_queue_depth = 0;
+    int decimation = 1; // Outputs per one kept, only grows with BACKPRESSURE_DECIMATE
+    double last_latency = 0.0; // Seconds from Submit until the write returned
+    double max_latency = 0.0;
+    double total_latency = 0.0;
+    double write_seconds = 0.0; // Time the writer spent in write calls
+    double blocked_seconds = 0.0; // Time Acquire waited for a free buffer
+};
+
+// Moves output off the stepping thread. The solver fills a buffer from the pool with
+// Grid::Capture and submits it with the function that writes it, a background thread then runs
+// the writes in submission order and puts the buffers back. Buffers keep their fields, so after
+// the first round the pool no longer allocates.
+struct SnapshotWriter {
+    using WriteFunction = std::function<bool(const Snapshot &)>;
+
+    SnapshotWriter(int nbuffers, int backpressure);
+
+    // Finishes every submitted write first
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    // Free buffer to fill, or nullptr if the backpressure policy skips this output. Required
+    // outputs, such as the final state, always wait for a buffer.
+    Snapshot *Acquire(bool required = false);
+
+    // Queues a buffer from Acquire, write runs on the writer thread
+    void Submit(Snapshot *buffer, WriteFunction write);
+
+    // Waits until every submitted write has finished
+    void Flush();
+
+    WriterStats Stats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        Snapshot *buffer;
+        WriteFunction write;
+        Clock::time_point submitted;
+    };
+
+    void Loop();
+
+    int backpressure;
+    std::vector<Snapshot> buffers;
+    long outputs = 0; // Calls to Acquire, for decimation
+
+    std::mutex mutex;
+    std::condition_variable wake; // Writer side, a job was queued or the writer is stopping
+    std::condition_variable freed; // Solver side, a job finished
+    std::vector<Snapshot *> free_buffers;
+    std::vector<Job> queue; // Oldest first
+    bool writing = false; // The writer is running a job it took off the queue
+    bool stopping = false;
+    WriterStats stats;
+
+    std::thread thread;
+};
+
+#endif //APEP_HYDRO_SNAPSHOTWRITER_H
@@ -0,0 +1,109 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "Trace.h"
+
+ThreadPool::ThreadPool(const int nthreads) : nthreads(std::max(1, nthreads)), shares(this->nthreads) {
+    for (int t = 1; t < this->nthreads; t++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker: workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Run(const int begin, const int end, const int grain, const Task task, void *ctx) {
+    if (begin >= end) {
+        return;
+    }
+    // Not worth waking anyone for a single chunk
+    if (nthreads == 1 || end - begin <= grain) {
+        task(ctx, begin, end, 0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = task;
+        this->ctx = ctx;
+        this->begin = begin;
+        this->end = end;
+        this->grain = std::max(1, grain);
+        // Deal the chunks out in contiguous shares
+        const int64_t nchunks = (end - begin + this->grain - 1) / this->grain;
+        for (int t = 0; t < nthreads; t++) {
+            const uint64_t lo = nchunks * t / nthreads;
+            const uint64_t hi = nchunks * (t + 1) / nthreads;
+            shares[t].range.store(lo | hi << 32, std::memory_order_relaxed);
+        }
+        active = nthreads - 1;
+        generation++;
+    }
+    wake.notify_all();
+    Work(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return active == 0; });
+}
+
+void ThreadPool::WorkerLoop(const int thread) {
+    TraceThreadName("Pool worker " + std::to_string(thread));
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        Work(thread);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+bool ThreadPool::Pop(Share &share, const bool back, int &chunk) {
+    uint64_t range = share.range.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t lo = range & 0xffffffffu;
+        uint64_t hi = range >> 32;
+        if (lo >= hi) {
+            return false;
+        }
+        chunk = static_cast<int>(back ? --hi : lo++);
+        if (share.range.compare_exchange_weak(range, lo | hi << 32, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void ThreadPool::RunChunk(const int chunk, const int thread) {
+    const int lo = begin + chunk * grain;
+    task(ctx, lo, std::min(lo + grain, end), thread);
+}
+
+void ThreadPool::Work(const int thread) {
+    int chunk;
+    while (Pop(shares[thread], false, chunk)) {
+        RunChunk(chunk, thread);
+    }
+    // Steal from the others, nearest neighbour first
+    for (int k = 1; k < nthreads; k++) {
+        Share &victim = shares[(thread + k) % nthreads];
+        while (Pop(victim, true, chunk)) {
+            RunChunk(chunk, thread);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef APEP_HYDRO_THREADPOOL_H
+#define APEP_HYDRO_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent pool of worker threads for the parallel loops of a time step. The calling thread
+// takes part as thread 0, so a pool of size 1 runs everything inline. Dispatching a loop does
+// not allocate.
+//
+// Loops are work-stealing: every thread starts on its own contiguous share of the chunks and
+// only takes chunks from the back of another thread's share once its own is done. A loop over
+// the same range therefore lands on the same threads every time unless the load is uneven.
+struct ThreadPool {
+    explicit ThreadPool(int nthreads);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int Size() const {
+        return nthreads;
+    }
+
+    // Calls body(lo, hi, thread) on chunks of at most grain indices covering [begin, end) and
+    // returns once all of them are done
+    template<typename F>
+    void ParallelFor(const int begin, const int end, const int grain, F &&body) {
+        using Body = std::remove_reference_t<F>;
+        Run(begin, end, grain, [](void *ctx, const int lo, const int hi, const int thread) {
+            (*static_cast<Body *>(ctx))(lo, hi, thread);
+        }, const_cast<void *>(static_cast<const void *>(&body)));
+    }
+
+private:
+    using Task = void (*)(void *ctx, int lo, int hi, int thread);
+
+    void Run(int begin, int end, int grain, Task task, void *ctx);
+
+    void WorkerLoop(int thread);
+
+    // Processes chunks of the current loop until none are left, own ones first
+    void Work(int thread);
+
+    // Chunk indices [lo, hi) still queued for one thread, packed as lo | hi << 32 so the owner
+    // popping from the front and thieves popping from the back agree through a single CAS
+    struct alignas(64) Share {
+        std::atomic<uint64_t> range{0};
+    };
+
+    // Takes the first (or, for a thief, the last) chunk of share, false if it is empty
+    static bool Pop(Share &share, bool back, int &chunk);
+
+    void RunChunk(int chunk, int thread);
+
+    int nthreads;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned generation = 0;
+    int active = 0; // Workers still busy with the current loop
+    bool stopping = false;
+
+    // Current loop
+    Task task = nullptr;
+    void *ctx = nullptr;
+    int begin = 0;
+    int end = 0;
+    int grain = 1;
+    std::vector<Share> shares; // One per thread
+};
+
+#endif //APEP_HYDRO_THREADPOOL_H
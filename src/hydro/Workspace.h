@@ -0,0 +1,69 @@
+#ifndef APEP_HYDRO_WORKSPACE_H
+#define APEP_HYDRO_WORKSPACE_H
+
+#include <algorithm>
+#include <vector>
+
+#include "Field.h"
+#include "Hydro.h"
+
+// Flux buffers long enough for a row or a column of interfaces of a tile
+struct PencilScratch {
+    QVec flux;
+    QVec flux_prev; // Fluxes of the previous interface row in the y-sweep
+
+    void Resize(const int n) {
+        flux.Resize(n);
+        flux_prev.Resize(n);
+    }
+};
+
+// Rectangular block of interior cells that is advanced as a unit. The tile keeps its own copy
+// of the primitive variables with a halo of nghost cells, so the flux, source and update phases
+// only touch memory of the tile and the data stays in cache between them.
+struct Tile {
+    int i0 = 0, j0 = 0; // First interior cell of the tile, in interior coordinates
+    int nx = 0, ny = 0;
+    Field2D rho, u, v, en; // Primitive variables including the halo, indexed like the grid fields
+    QVec2 res; // Residual of the tile cells
+    PencilScratch scratch;
+    float max_rate = 0.0f; // Largest signal rate of the last stage, for the next time step
+
+    void Resize(const int i0, const int j0, const int nx, const int ny, const int nghost) {
+        this->i0 = i0;
+        this->j0 = j0;
+        this->nx = nx;
+        this->ny = ny;
+        for (Field2D *f: {&rho, &u, &v, &en}) {
+            f->Resize(nx + 2 * nghost, ny + 2 * nghost);
+        }
+        res.Resize(nx, ny);
+        scratch.Resize(std::max(nx, ny) + 2 * nghost);
+    }
+};
+
+// Scratch memory for Grid::TimeStep. Sized once by Grid::Resize and reused by every step,
+// so stepping itself never allocates.
+struct Workspace {
+    QVec2 cons0; // Conserved state at the start of the step
+    std::vector<Tile> tiles; // Row-major over the grid
+    int tiles_x = 0; // Tiles per row of tiles
+
+    // Splits the nx * ny interior into tiles of at most tile_nx * tile_ny cells. Tiles are at
+    // least nghost rows high, so only the first and last row of tiles reach into the ghost rows.
+    void Resize(const int nx, const int ny, const int nghost, const int tile_nx, const int tile_ny) {
+        cons0.Resize(nx, ny);
+        const int tnx = std::clamp(tile_nx, 1, std::max(nx, 1));
+        const int tny = std::clamp(tile_ny, std::max(1, std::min(nghost, ny)), std::max(ny, 1));
+        tiles_x = (nx + tnx - 1) / tnx;
+        tiles.clear();
+        for (int j0 = 0; j0 < ny; j0 += tny) {
+            for (int i0 = 0; i0 < nx; i0 += tnx) {
+                tiles.emplace_back();
+                tiles.back().Resize(i0, j0, std::min(tnx, nx - i0), std::min(tny, ny - j0), nghost);
+            }
+        }
+    }
+};
+
+#endif //APEP_HYDRO_WORKSPACE_H
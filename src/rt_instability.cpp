@@ -1,46 +1,122 @@
+#include "cxxopts.hpp"
 #include "implot.h"
 #include "app/App.h"
-#include "hydro/Grid.h"
+#include "hydro/Simulation.h"
+#include "ui/DiagnosticsPanel.h"
+#include "ui/PerformancePanel.h"
+#include "ui/SettingsPanel.h"
+#include "ui/SnapshotView.h"
 #include "utils/Settings.h"
+#include "utils/Trace.h"
 
 struct RTInstabilityApp : App {
   using App::App;
   RTSettings settings;
-  Grid grid = Grid(settings);
+  // Steps the grid on its own thread, the frame only sends commands and draws snapshots
+  Simulation simulation = Simulation(settings);
+  int playing_sent = 0;
+  // Phase timers run only while the HUD is shown
+  bool show_performance = false;
+  bool count_events = false;
+  Profiler ui_profiler;
+  bool recording_trace = false;
+  char trace_filename[256] = "trace.json";
+  // A snapshot file shown in place of the live grid, e.g. one gathered from an MPI run
+  Snapshot file_snapshot;
+  bool viewing_file = false;
+  unsigned files_opened = 0;
+  char snapshot_filename[256] = "";
+
+  bool OpenSnapshot(const char *filename) {
+    if (!file_snapshot.Read(filename)) {
+      return false;
+    }
+    // A serial the live snapshots never reach, so the view uploads the fields again
+    file_snapshot.serial = ~0u - files_opened++;
+    viewing_file = true;
+    return true;
+  }
 
   void Update() override {
     ImGui::Begin("Status", NULL, ImGuiWindowFlags_AlwaysAutoResize);
     ImGuiIO &io = ImGui::GetIO();
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+    if (ImGui::Checkbox("Performance HUD", &show_performance)) {
+      simulation.Profile(show_performance);
+      ui_profiler.enabled = show_performance;
+    }
+    if (show_performance && ImGui::Checkbox("Hardware counters", &count_events)) {
+      simulation.Count(count_events);
+    }
+    // Records every thread into a timeline for chrome://tracing or ui.perfetto.dev
+    if (ImGui::Checkbox("Record trace", &recording_trace)) {
+      if (recording_trace) {
+        GlobalTrace().Start();
+      } else {
+        GlobalTrace().Stop();
+      }
+    }
+    ImGui::InputText("##trace_filename", trace_filename, sizeof(trace_filename));
+    ImGui::SameLine();
+    if (ImGui::Button("Save trace")) {
+      GlobalTrace().Write(trace_filename);
+    }
+    ImGui::InputText("##snapshot_filename", snapshot_filename, sizeof(snapshot_filename));
+    ImGui::SameLine();
+    if (ImGui::Button("Open snapshot")) {
+      OpenSnapshot(snapshot_filename);
+    }
+    if (viewing_file) {
+      ImGui::SameLine();
+      if (ImGui::Button("Back to live")) {
+        viewing_file = false;
+      }
+    }
     ImGui::End();
 
-    settings.Update();
+    SettingsPanel(settings);
     if (settings.resetting > 0) {
-      grid.Clear();
-      grid.Reset(settings);
+      simulation.Send(RESET, settings);
       settings.resetting = 0;
     }
-    grid.Update();
-    if (grid.time < settings.tmax && settings.playing) {
-      for (int i = 0; i < settings.cycles_per_frame; i++) {
-        grid.TimeStep();
-        grid.time += grid.dt;
-        if (grid.time >= settings.tmax) {
-          settings.playing = 0;
-          break;
-        }
-      }
+    if (settings.playing != playing_sent) {
+      simulation.Send(settings.playing ? PLAY : PAUSE, settings);
+      playing_sent = settings.playing;
     }
-    if (!settings.playing && settings.advance) {
-      grid.TimeStep();
-      grid.time += grid.dt;
+    if (settings.advance > 0) {
+      simulation.Send(ADVANCE, settings);
       settings.advance = 0;
     }
+
+    simulation.Acquire();
+    const Snapshot &snapshot = simulation.Latest();
+    // The simulation pauses itself at tmax, follow it unless a newer command is still on its way
+    if (simulation.Synced(snapshot) && snapshot.playing != static_cast<bool>(settings.playing)) {
+      settings.playing = playing_sent = snapshot.playing;
+    }
+    SnapshotView(viewing_file ? file_snapshot : snapshot, ui_profiler);
+    DiagnosticsPanel(snapshot);
+    if (show_performance) {
+      PerformancePanel(snapshot, ui_profiler);
+    }
   }
 };
 
 int main(int argc, char const *argv[]) {
+  cxxopts::Options options("rt_instability");
+  options.add_options()("t,threads", "Solver threads, 0 uses every hardware thread", cxxopts::value<int>());
+  options.add_options()("view", "Snapshot file to show instead of the live grid", cxxopts::value<std::string>());
+  options.allow_unrecognised_options();
+  auto result = options.parse(argc, argv);
+
   RTInstabilityApp app("Rayleigh-Taylor Instability", 1920, 1080, argc, argv);
+  if (result.count("threads")) {
+    app.settings.nthreads = result["threads"].as<int>();
+    app.settings.resetting = 1;
+  }
+  if (result.count("view") && !app.OpenSnapshot(result["view"].as<std::string>().c_str())) {
+    return EXIT_FAILURE;
+  }
   app.Run();
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,115 @@
+#include "DiagnosticsPanel.h"
+
+#include <vector>
+
+#include "imgui.h"
+#include "implot.h"
+
+// Samples kept per series, the oldest are overwritten first
+static constexpr int HISTORY_SIZE = 4096;
+
+// Ring of (time, value) points that ImPlot draws starting at offset
+struct ScrollingSeries {
+    std::vector<ImVec2> points;
+    int offset = 0;
+
+    void Add(const float t, const float value) {
+        if (static_cast<int>(points.size()) < HISTORY_SIZE) {
+            points.emplace_back(t, value);
+        } else {
+            points[offset] = ImVec2(t, value);
+            offset = (offset + 1) % HISTORY_SIZE;
+        }
+    }
+
+    void Clear() {
+        points.clear();
+        offset = 0;
+    }
+
+    void Plot(const char *label) const {
+        if (!points.empty()) {
+            ImPlot::PlotLine(label, &points[0].x, &points[0].y, static_cast<int>(points.size()), 0, offset,
+                             sizeof(ImVec2));
+        }
+    }
+};
+
+enum SeriesType {
+    SERIES_MASS = 0,
+    SERIES_ENERGY,
+    SERIES_BUBBLE,
+    SERIES_SPIKE,
+    SERIES_WIDTH,
+    SERIES_KINETIC,
+    SERIES_MACH,
+    SERIES_COUNT,
+};
+
+void DiagnosticsPanel(const Snapshot &snapshot) {
+    static ScrollingSeries series[SERIES_COUNT];
+    static Diagnostics first; // Reference for the conservation errors
+    static long last_step = -1;
+    static float history = 2.0f; // Simulated time shown in the plots
+
+    const Diagnostics &d = snapshot.diagnostics;
+    if (snapshot.nx > 0 && d.step != last_step) {
+        if (d.step < last_step || last_step < 0) {
+            for (ScrollingSeries &s: series) {
+                s.Clear();
+            }
+            first = d;
+        }
+        last_step = d.step;
+        const float t = static_cast<float>(d.time);
+        // Relative changes are computed in double, the totals are too close for floats
+        series[SERIES_MASS].Add(t, static_cast<float>((d.mass - first.mass) / first.mass));
+        const double total = first.energy + first.potential;
+        series[SERIES_ENERGY].Add(t, static_cast<float>((d.energy + d.potential - total) / total));
+        series[SERIES_BUBBLE].Add(t, static_cast<float>(d.bubble));
+        series[SERIES_SPIKE].Add(t, static_cast<float>(d.spike));
+        series[SERIES_WIDTH].Add(t, static_cast<float>(d.mix_width));
+        series[SERIES_KINETIC].Add(t, static_cast<float>(d.kinetic));
+        series[SERIES_MACH].Add(t, static_cast<float>(d.max_mach));
+    }
+
+    ImGui::Begin("Diagnostics");
+    ImGui::Text("Mass: %.9g", d.mass);
+    ImGui::Text("Momentum: %.4g, %.4g", d.momentum_x, d.momentum_y);
+    ImGui::Text("Energy: %.9g (kinetic %.4g, potential %.9g)", d.energy, d.kinetic, d.potential);
+    ImGui::Text("Bubble: %.4f  Spike: %.4f  Mixing width: %.4f", d.bubble, d.spike, d.mix_width);
+    ImGui::Text("Max Mach: %.3f", d.max_mach);
+    ImGui::SetNextItemWidth(225);
+    ImGui::SliderFloat("History", &history, 0.1f, 20.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+
+    const double t = d.time;
+    const ImVec2 size(-1, 200);
+    const auto setup = [&](const char *y_label) {
+        ImPlot::SetupAxes("time", y_label, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+        ImPlot::SetupAxisLimits(ImAxis_X1, t - history, t, ImGuiCond_Always);
+    };
+    if (ImPlot::BeginPlot("Mixing Layer", size)) {
+        setup("height");
+        series[SERIES_BUBBLE].Plot("Bubble");
+        series[SERIES_SPIKE].Plot("Spike");
+        series[SERIES_WIDTH].Plot("Width");
+        ImPlot::EndPlot();
+    }
+    if (ImPlot::BeginPlot("Conservation", size)) {
+        setup("relative change");
+        series[SERIES_MASS].Plot("Mass");
+        series[SERIES_ENERGY].Plot("Energy + Potential");
+        ImPlot::EndPlot();
+    }
+    if (ImPlot::BeginPlot("Kinetic Energy", size)) {
+        setup("energy");
+        series[SERIES_KINETIC].Plot("Kinetic");
+        ImPlot::EndPlot();
+    }
+    if (ImPlot::BeginPlot("Max Mach", size)) {
+        setup("Mach");
+        series[SERIES_MACH].Plot("Mach");
+        ImPlot::EndPlot();
+    }
+    ImGui::End();
+}
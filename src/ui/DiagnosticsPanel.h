@@ -0,0 +1,10 @@
+#ifndef APEP_UI_DIAGNOSTICSPANEL_H
+#define APEP_UI_DIAGNOSTICSPANEL_H
+
+#include "Snapshot.h"
+
+// Window with the diagnostics of the latest snapshot and scrolling plots of their history.
+// The history starts over when the simulation is reset.
+void DiagnosticsPanel(const Snapshot &snapshot);
+
+#endif //APEP_UI_DIAGNOSTICSPANEL_H
@@ -0,0 +1,269 @@
+#include "HeatmapTexture.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static const char *VERTEX_SHADER = R"(#version 330 core
+out vec2 uv;
+void main() {
+    // One triangle covering the viewport, from the vertex index alone
+    uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char *FRAGMENT_SHADER = R"(#version 330 core
+in vec2 uv;
+out vec4 color;
+uniform sampler2D field;
+uniform sampler1D lut;
+uniform float scale_min;
+uniform float inv_range;
+void main() {
+    color = texture(lut, clamp((texture(field, uv).r - scale_min) * inv_range, 0.0, 1.0));
+}
+)";
+
+static GLuint compile_shader(const GLenum type, const char *source) {
+    const GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        fprintf(stderr, "Heatmap shader: %s\n", log);
+    }
+    return shader;
+}
+
+// Colormap program, shared by every heatmap and built on first use
+static GLuint colormap_program() {
+    static GLuint program = 0;
+    if (program != 0) {
+        return program;
+    }
+    const GLuint vs = compile_shader(GL_VERTEX_SHADER, VERTEX_SHADER);
+    const GLuint fs = compile_shader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    GLint ok = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        fprintf(stderr, "Heatmap program: %s\n", log);
+    }
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "field"), 0);
+    glUniform1i(glGetUniformLocation(program, "lut"), 1);
+    return program;
+}
+
+// The core profile needs a vertex array bound to draw, even without attributes
+static GLuint empty_vertex_array() {
+    static GLuint vao = 0;
+    if (vao == 0) {
+        glGenVertexArrays(1, &vao);
+    }
+    return vao;
+}
+
+static GLuint new_texture(const GLenum target, const GLint filter) {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+HeatmapTexture::~HeatmapTexture() {
+    Release();
+}
+
+void HeatmapTexture::Release() {
+    if (field_texture == 0) {
+        return;
+    }
+    for (UploadBuffer &upload: uploads) {
+        if (upload.fence != nullptr) {
+            glDeleteSync(upload.fence);
+        }
+        if (upload.buffer != 0) {
+            glDeleteBuffers(1, &upload.buffer);
+        }
+        upload = UploadBuffer();
+    }
+    const GLuint textures[3] = {field_texture, color_texture, lut_texture};
+    glDeleteTextures(3, textures);
+    glDeleteFramebuffers(1, &framebuffer);
+    field_texture = color_texture = lut_texture = framebuffer = 0;
+    lut_map = -1;
+    nx = ny = stride = 0;
+}
+
+void HeatmapTexture::Resize(const int nx, const int ny, const int stride) {
+    Release();
+    this->nx = nx;
+    this->ny = ny;
+    this->stride = stride;
+    GLint texture = 0, texture_1d = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+    glGetIntegerv(GL_TEXTURE_BINDING_1D, &texture_1d);
+
+    // Nearest filtering keeps the cells sharp when the heatmap is scaled up
+    field_texture = new_texture(GL_TEXTURE_2D, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, nx, ny, 0, GL_RED, GL_FLOAT, nullptr);
+    color_texture = new_texture(GL_TEXTURE_2D, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, nx, ny, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    lut_texture = new_texture(GL_TEXTURE_1D, GL_LINEAR);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, LUT_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    GLint bound_framebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_framebuffer);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, bound_framebuffer);
+
+    // Without buffer storage every upload maps the buffer again, orphaning its old contents
+    const GLsizeiptr bytes = static_cast<GLsizeiptr>(stride) * ny * sizeof(float);
+    const GLbitfield persistent = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    for (UploadBuffer &upload: uploads) {
+        glGenBuffers(1, &upload.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+        if (GLAD_GL_VERSION_4_4) {
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, persistent);
+            upload.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, persistent);
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindTexture(GL_TEXTURE_1D, texture_1d);
+}
+
+void HeatmapTexture::Upload(const Field2D &field, const int nx, const int ny) {
+    if (nx <= 0 || ny <= 0) {
+        return;
+    }
+    if (nx != this->nx || ny != this->ny || field.stride != stride) {
+        Resize(nx, ny, field.stride);
+    }
+    UploadBuffer &upload = uploads[next_upload];
+    next_upload = (next_upload + 1) % UPLOAD_BUFFERS;
+    // The buffer was last used UPLOAD_BUFFERS uploads ago, so this rarely has to wait
+    if (upload.fence != nullptr) {
+        glClientWaitSync(upload.fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+        glDeleteSync(upload.fence);
+        upload.fence = nullptr;
+    }
+    // The padded rows go as they are, the unpack row length skips the padding
+    const size_t bytes = static_cast<size_t>(stride) * ny * sizeof(float);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+    if (upload.mapped != nullptr) {
+        std::memcpy(upload.mapped, field.data, bytes);
+    } else {
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes),
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        std::memcpy(mapped, field.data, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    GLint texture = 0, row_length = 0, alignment = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &row_length);
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, field_texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, nx, ny, GL_RED, GL_FLOAT, nullptr);
+    upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    dirty = true;
+}
+
+void HeatmapTexture::Render(const ImPlotColormap map, const float scale_min, const float scale_max) {
+    if (field_texture == 0) {
+        return;
+    }
+    const bool new_map = map != lut_map;
+    if (!dirty && !new_map && scale_min == rendered_min && scale_max == rendered_max) {
+        return;
+    }
+    GLint program = 0, vao = 0, active_texture = 0, texture_2d = 0, texture_1d = 0, bound_framebuffer = 0;
+    GLint viewport[4];
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &active_texture);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    const GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+    glActiveTexture(GL_TEXTURE1);
+    glGetIntegerv(GL_TEXTURE_BINDING_1D, &texture_1d);
+    glBindTexture(GL_TEXTURE_1D, lut_texture);
+    if (new_map) {
+        // Same colors PlotHeatmap would use, interpolated between the colormap entries
+        uint8_t lut[LUT_SIZE][4];
+        for (int k = 0; k < LUT_SIZE; k++) {
+            const ImU32 color = ImGui::ColorConvertFloat4ToU32(
+                ImPlot::SampleColormap(static_cast<float>(k) / (LUT_SIZE - 1), map));
+            std::memcpy(lut[k], &color, sizeof(color));
+        }
+        glTexSubImage1D(GL_TEXTURE_1D, 0, 0, LUT_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, lut);
+        lut_map = map;
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture_2d);
+    glBindTexture(GL_TEXTURE_2D, field_texture);
+
+    const GLuint colormap = colormap_program();
+    glUseProgram(colormap);
+    glUniform1f(glGetUniformLocation(colormap, "scale_min"), scale_min);
+    glUniform1f(glGetUniformLocation(colormap, "inv_range"),
+                scale_max != scale_min ? 1.0f / (scale_max - scale_min) : 0.0f);
+    glBindVertexArray(empty_vertex_array());
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, nx, ny);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // ImGui renders later in the frame, leave the state as it was
+    glBindFramebuffer(GL_FRAMEBUFFER, bound_framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (blend) {
+        glEnable(GL_BLEND);
+    }
+    if (scissor) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+    glBindVertexArray(vao);
+    glUseProgram(program);
+    glBindTexture(GL_TEXTURE_2D, texture_2d);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, texture_1d);
+    glActiveTexture(active_texture);
+    dirty = false;
+    rendered_min = scale_min;
+    rendered_max = scale_max;
+}
+
+void HeatmapTexture::Draw(const ImVec2 size) const {
+    // Texture row 0 is the bottom row of the grid, ImGui puts v = 0 at the top
+    ImGui::Image(reinterpret_cast<ImTextureID>(static_cast<intptr_t>(color_texture)), size, ImVec2(0, 1), ImVec2(1, 0));
+}
@@ -0,0 +1,60 @@
+#ifndef APEP_UI_HEATMAPTEXTURE_H
+#define APEP_UI_HEATMAPTEXTURE_H
+
+#include <glad/glad.h>
+
+#include "Field.h"
+#include "imgui.h"
+#include "implot.h"
+
+// Heatmap of a field drawn by the GPU. The field is streamed into a float texture through a
+// ring of pixel buffers, so the upload never waits for the texture to be read, and a fragment
+// shader maps the values to colors with a lookup texture sampled from the ImPlot colormap. The
+// result is a single texture per field for ImGui::Image, instead of two triangles per cell.
+// Needs a current OpenGL 3.3 context, and persistent buffer mapping where the driver has it.
+struct HeatmapTexture {
+    HeatmapTexture() = default;
+
+    HeatmapTexture(const HeatmapTexture &) = delete;
+
+    HeatmapTexture &operator=(const HeatmapTexture &) = delete;
+
+    ~HeatmapTexture();
+
+    // Copies the interior of field, nx * ny cells with row 0 at the bottom, to the GPU
+    void Upload(const Field2D &field, int nx, int ny);
+
+    // Recolors the uploaded field if it, the colormap or the scale changed since the last call
+    void Render(ImPlotColormap map, float scale_min, float scale_max);
+
+    // Draws the colored field with y up
+    void Draw(ImVec2 size) const;
+
+private:
+    static constexpr int UPLOAD_BUFFERS = 3;
+    static constexpr int LUT_SIZE = 256;
+
+    struct UploadBuffer {
+        GLuint buffer = 0;
+        void *mapped = nullptr; // Persistent mapping, null when the buffer is mapped per upload
+        GLsync fence = nullptr; // Signalled once the texture upload from the buffer is done
+    };
+
+    int nx = 0, ny = 0;
+    int stride = 0; // Row length of the uploaded field in floats
+    GLuint field_texture = 0; // Field values, GL_R32F
+    GLuint color_texture = 0; // Colored field, what ImGui draws
+    GLuint framebuffer = 0;
+    GLuint lut_texture = 0;
+    UploadBuffer uploads[UPLOAD_BUFFERS];
+    int next_upload = 0;
+    bool dirty = false; // Uploaded since the last Render
+    ImPlotColormap lut_map = -1;
+    float rendered_min = 0.0f, rendered_max = 0.0f;
+
+    void Resize(int nx, int ny, int stride);
+
+    void Release();
+};
+
+#endif //APEP_UI_HEATMAPTEXTURE_H
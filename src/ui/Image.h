@@ -1,10 +1,11 @@
-#ifndef APEP_APP_IMAGE_H
-#define APEP_APP_IMAGE_H
+#ifndef APEP_UI_IMAGE_H
+#define APEP_UI_IMAGE_H
 
+#include <cstring>
 #include <iostream>
 #include <ostream>
-#include <vector>
 
+#include "Field.h"
 #include "imgui.h"
 
 // Struct to store 2D vectors as 2D arrays
@@ -13,7 +14,7 @@ struct Image {
     float *data;
     float aspect_ratio;
 
-    Image(int nghost, int nx, int ny, const std::vector<std::vector<float> > &value);
+    Image(int nghost, int nx, int ny, const Field2D &value);
 
     void Print();
 
@@ -24,18 +25,15 @@ struct Image {
     ImVec2 GetWindowSize() const;
 };
 
-inline Image::Image(const int nghost, const int nx, const int ny,
-                    const std::vector<std::vector<float> > &value) {
-    // Important: We transpose the data here to match the ImPlot heatmap
+inline Image::Image(const int nghost, const int nx, const int ny, const Field2D &value) {
+    // ImPlot heatmaps are row-major from the top, so rows are copied in reverse y order
     this->nx = ny;
     this->ny = nx;
     this->data = new float[ny * nx];
     const int max = ny + nghost;
     aspect_ratio = static_cast<float>(nx) / ny;
-    for (int i = 0; i < nx; i++) {
-        for (int j = 0; j < ny; j++) {
-            data[j * nx + i] = value[nghost + i][max - (j + 1)];
-        }
+    for (int j = 0; j < ny; j++) {
+        std::memcpy(data + j * nx, value.Row(max - (j + 1)) + nghost, nx * sizeof(float));
     }
 }
 
@@ -64,4 +62,4 @@ inline ImVec2 Image::GetWindowSize() const {
 
     return ImVec2(width, height);
 }
-#endif //APEP_APP_IMAGE_H
+#endif //APEP_UI_IMAGE_H
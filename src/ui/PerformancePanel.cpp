@@ -0,0 +1,246 @@
+#include "PerformancePanel.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "imgui.h"
+#include "implot.h"
+
+// Samples kept per chart, one per snapshot for the steps and one per frame for the UI
+static constexpr int HISTORY_SIZE = 600;
+
+// Rolling window of samples with one value per series, in milliseconds
+struct History {
+    int nseries = 0;
+    std::vector<float> values; // Sample-major
+
+    explicit History(const int nseries) : nseries(nseries) {
+    }
+
+    int Size() const {
+        return static_cast<int>(values.size()) / nseries;
+    }
+
+    void Add(const float *sample) {
+        if (Size() == HISTORY_SIZE) {
+            values.erase(values.begin(), values.begin() + nseries);
+        }
+        values.insert(values.end(), sample, sample + nseries);
+    }
+
+    void Clear() {
+        values.clear();
+    }
+
+    // Min, mean and 99th percentile of a series
+    void Stats(const int series, float &min, float &mean, float &p99) const {
+        std::vector<float> column(Size());
+        for (int s = 0; s < Size(); s++) {
+            column[s] = values[s * nseries + series];
+        }
+        if (column.empty()) {
+            min = mean = p99 = 0.0f;
+            return;
+        }
+        min = *std::min_element(column.begin(), column.end());
+        double sum = 0.0;
+        for (const float v: column) {
+            sum += v;
+        }
+        mean = static_cast<float>(sum / column.size());
+        const size_t k = (column.size() * 99) / 100;
+        std::nth_element(column.begin(), column.begin() + k, column.end());
+        p99 = column[k];
+    }
+
+    // Series drawn on top of each other as shaded bands
+    void PlotStacked(const char *const *labels) const {
+        const int n = Size();
+        std::vector<float> xs(n), lower(n, 0.0f), upper(n);
+        for (int s = 0; s < n; s++) {
+            xs[s] = static_cast<float>(s - n + 1);
+        }
+        for (int k = 0; k < nseries; k++) {
+            for (int s = 0; s < n; s++) {
+                upper[s] = lower[s] + values[s * nseries + k];
+            }
+            ImPlot::PlotShaded(labels[k], xs.data(), lower.data(), upper.data(), n);
+            std::swap(lower, upper);
+        }
+    }
+};
+
+// Series of the step chart: the step phases and what the step spent outside them
+static constexpr int STEP_SERIES = STEP_PHASE_COUNT + 1;
+// Series of the frame chart: the UI phases and the rest of the frame
+static constexpr int FRAME_SERIES = PHASE_COUNT - STEP_PHASE_COUNT + 1;
+
+static void stats_rows(const History &history, const char *const *labels, const float total_ms) {
+    for (int k = 0; k < history.nseries; k++) {
+        float min, mean, p99;
+        history.Stats(k, min, mean, p99);
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(labels[k]);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", min);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", mean);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", p99);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f%%", total_ms > 0.0f ? 100.0f * mean / total_ms : 0.0f);
+    }
+}
+
+// Hardware counts per cell and step of the step phases that were counted
+static void counter_table(const PhaseTimes &counted, const double cells) {
+    if (ImGui::BeginTable("Counters", COUNTER_COUNT + 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        ImGui::TableSetupColumn("Phase");
+        ImGui::TableSetupColumn("IPC");
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            ImGui::TableSetupColumn(CounterName(c));
+        }
+        ImGui::TableHeadersRow();
+        const double per_cell = 1.0 / (cells * counted.steps);
+        for (int p = 0; p < STEP_PHASE_COUNT; p++) {
+            const double *counts = counted.counts[p];
+            if (counts[COUNTER_CYCLES] <= 0.0) {
+                continue;
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(PhaseName(p));
+            ImGui::TableNextColumn();
+            if (counted.counted[COUNTER_INSTRUCTIONS]) {
+                ImGui::Text("%.2f", counts[COUNTER_INSTRUCTIONS] / counts[COUNTER_CYCLES]);
+            } else {
+                ImGui::TextUnformatted("n/a");
+            }
+            for (int c = 0; c < COUNTER_COUNT; c++) {
+                ImGui::TableNextColumn();
+                if (counted.counted[c]) {
+                    ImGui::Text("%.3g", counts[c] * per_cell);
+                } else {
+                    ImGui::TextUnformatted("n/a");
+                }
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
+void PerformancePanel(const Snapshot &snapshot, Profiler &profiler) {
+    static History steps(STEP_SERIES);
+    static History frames(FRAME_SERIES);
+    static History rates(1); // Mzone-cycles/s per snapshot
+    static long last_step = -1;
+    static unsigned last_serial = 0;
+    static PhaseTimes counted; // Latest snapshot with hardware counts
+    static const char *step_labels[STEP_SERIES];
+    static const char *frame_labels[FRAME_SERIES];
+    if (step_labels[0] == nullptr) {
+        for (int p = 0; p < STEP_PHASE_COUNT; p++) {
+            step_labels[p] = PhaseName(p);
+        }
+        step_labels[STEP_PHASE_COUNT] = "Other";
+        for (int p = STEP_PHASE_COUNT; p < PHASE_COUNT; p++) {
+            frame_labels[p - STEP_PHASE_COUNT] = PhaseName(p);
+        }
+        frame_labels[FRAME_SERIES - 1] = "Rest of frame";
+    }
+
+    if (snapshot.serial != last_serial) {
+        // Settings changed, the old samples belong to another grid
+        steps.Clear();
+        rates.Clear();
+        counted = PhaseTimes();
+        last_serial = snapshot.serial;
+    }
+    const PhaseTimes &phases = snapshot.phases;
+    if (snapshot.step != last_step && phases.steps > 0) {
+        float sample[STEP_SERIES];
+        float timed = 0.0f;
+        for (int p = 0; p < STEP_PHASE_COUNT; p++) {
+            sample[p] = static_cast<float>(1.0e3 * phases.seconds[p] / phases.steps);
+            timed += sample[p];
+        }
+        const float step_ms = static_cast<float>(1.0e3 * phases.step_seconds / phases.steps);
+        sample[STEP_PHASE_COUNT] = std::max(0.0f, step_ms - timed);
+        steps.Add(sample);
+        const double cells = static_cast<double>(snapshot.nx) * snapshot.ny / (snapshot.refinement * snapshot.refinement);
+        const float rate = static_cast<float>(cells * phases.steps / phases.step_seconds * 1.0e-6);
+        rates.Add(&rate);
+        if (phases.counted[COUNTER_CYCLES]) {
+            counted = phases;
+        }
+    }
+    last_step = snapshot.step;
+
+    const PhaseTimes ui = profiler.Collect();
+    float frame_sample[FRAME_SERIES];
+    float timed = 0.0f;
+    for (int p = STEP_PHASE_COUNT; p < PHASE_COUNT; p++) {
+        frame_sample[p - STEP_PHASE_COUNT] = static_cast<float>(1.0e3 * ui.seconds[p]);
+        timed += frame_sample[p - STEP_PHASE_COUNT];
+    }
+    frame_sample[FRAME_SERIES - 1] = std::max(0.0f, 1.0e3f * ImGui::GetIO().DeltaTime - timed);
+    frames.Add(frame_sample);
+
+    ImGui::Begin("Performance");
+    float rate_min, rate_mean, rate_p99;
+    rates.Stats(0, rate_min, rate_mean, rate_p99);
+    const float latest = rates.Size() > 0 ? rates.values.back() : 0.0f;
+    ImGui::Text("%.2f Mzone-cycles/s, %.2f mean over the window", latest, rate_mean);
+    if (steps.Size() == 0) {
+        ImGui::Text("Waiting for timed steps");
+    }
+
+    const ImVec2 size(-1, 220);
+    if (ImPlot::BeginPlot("Step", size)) {
+        ImPlot::SetupAxes("snapshot", "ms per step", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+        steps.PlotStacked(step_labels);
+        ImPlot::EndPlot();
+    }
+    if (ImPlot::BeginPlot("Frame", size)) {
+        ImPlot::SetupAxes("frame", "ms per frame", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+        frames.PlotStacked(frame_labels);
+        ImPlot::EndPlot();
+    }
+
+    if (ImGui::BeginTable("Phases", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        ImGui::TableSetupColumn("Phase");
+        ImGui::TableSetupColumn("Min ms");
+        ImGui::TableSetupColumn("Mean ms");
+        ImGui::TableSetupColumn("p99 ms");
+        ImGui::TableSetupColumn("Share");
+        ImGui::TableHeadersRow();
+        float step_total = 0.0f, frame_total = 0.0f;
+        for (int k = 0; k < STEP_SERIES; k++) {
+            float min, mean, p99;
+            steps.Stats(k, min, mean, p99);
+            step_total += mean;
+        }
+        for (int k = 0; k < FRAME_SERIES; k++) {
+            float min, mean, p99;
+            frames.Stats(k, min, mean, p99);
+            frame_total += mean;
+        }
+        stats_rows(steps, step_labels, step_total);
+        stats_rows(frames, frame_labels, frame_total);
+        ImGui::EndTable();
+    }
+
+    if (ImGui::CollapsingHeader("Hardware counters per cell and step")) {
+        if (counted.steps > 0) {
+            const double cells = static_cast<double>(snapshot.nx) * snapshot.ny /
+                                 (snapshot.refinement * snapshot.refinement);
+            counter_table(counted, cells);
+        } else {
+            // perf_event_open needs a PMU, which many VMs lack, and perf_event_paranoid <= 2
+            ImGui::TextWrapped("No counts yet. Switch on the hardware counters in the Status window, they are "
+                               "read with perf_event_open on Linux where the CPU and the kernel allow it.");
+        }
+    }
+    ImGui::End();
+}
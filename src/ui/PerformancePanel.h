@@ -0,0 +1,12 @@
+#ifndef APEP_UI_PERFORMANCEPANEL_H
+#define APEP_UI_PERFORMANCEPANEL_H
+
+#include "Profiler.h"
+#include "Snapshot.h"
+
+// Window with the phase timers of the simulation steps and the UI frame: rolling stacked charts
+// of where a step and a frame go, a table of min, mean and p99 per phase and the zone-cycles
+// per second. Collects the UI phases from profiler once per frame.
+void PerformancePanel(const Snapshot &snapshot, Profiler &profiler);
+
+#endif //APEP_UI_PERFORMANCEPANEL_H
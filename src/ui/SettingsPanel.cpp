@@ -0,0 +1,140 @@
+#include "SettingsPanel.h"
+
+#include <algorithm>
+
+#include "Amr.h"
+
+#include "imgui.h"
+
+void SettingsPanel(RTSettings &settings) {
+    ImGui::Begin("RT Instability Settings", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::InputInt("nx", &settings.nx);
+    ImGui::InputInt("ny", &settings.ny);
+    ImGui::InputInt("nghost", &settings.nghost);
+    ImGui::InputFloat("rho_ini_upper", &settings.rho_ini_upper);
+    ImGui::InputFloat("rho_ini_lower", &settings.rho_ini_lower);
+    ImGui::InputFloat("en_ini", &settings.en_ini);
+    ImGui::InputFloat("grav_x_init", &settings.grav_x_ini);
+    ImGui::InputFloat("grav_y_init", &settings.grav_y_ini);
+    ImGui::InputFloat("perturb_strength", &settings.perturb_strength);
+    ImGui::InputFloat("x1", &settings.x1);
+    ImGui::InputFloat("x2", &settings.x2);
+    ImGui::InputFloat("y1", &settings.y1);
+    ImGui::InputFloat("y2", &settings.y2);
+    ImGui::InputFloat("tmax", &settings.tmax);
+    ImGui::InputFloat("cfl", &settings.cfl);
+    ImGui::InputFloat("dt_growth", &settings.dt_growth);
+    ImGui::InputFloat("gamma_ad", &settings.gamma_ad);
+    ImGui::InputInt("threads (0 = all)", &settings.nthreads);
+    ImGui::InputInt("tile_nx", &settings.tile_nx);
+    ImGui::InputInt("tile_ny", &settings.tile_ny);
+    if (ImGui::CollapsingHeader("Reconstruction Method")) {
+        const char *items[] = {"Constant", "Linear"};
+        static int item_current = 1;
+        if (ImGui::BeginListBox("Reconstruction Method")) {
+            for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
+                const bool is_selected = (item_current == n);
+                if (ImGui::Selectable(items[n], is_selected)) {
+                    item_current = n;
+                    settings.reconstruct_type = n;
+                }
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndListBox();
+        }
+    }
+    if (ImGui::CollapsingHeader("Slope Limiter")) {
+        const char *items[] = {"minmod", "MC", "van Leer"};
+        static int item_current = 0;
+        if (ImGui::BeginListBox("Slope Limiter")) {
+            for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
+                const bool is_selected = (item_current == n);
+                if (ImGui::Selectable(items[n], is_selected)) {
+                    item_current = n;
+                    settings.limiter_type = n;
+                }
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndListBox();
+        }
+    }
+    if (ImGui::CollapsingHeader("Riemann Solver")) {
+        const char *items[] = {"HLLE", "HLLC", "HLLC (SIMD)"};
+        static int item_current = 2;
+        if (ImGui::BeginListBox("Riemann Solver")) {
+            for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
+                const bool is_selected = (item_current == n);
+                if (ImGui::Selectable(items[n], is_selected)) {
+                    item_current = n;
+                    settings.riemann_solver_type = n;
+                }
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndListBox();
+        }
+    }
+    if (ImGui::CollapsingHeader("Integrator")) {
+        const char *items[] = {"Euler", "RK2"};
+        static int item_current = 1;
+        if (ImGui::BeginListBox("Integrator")) {
+            for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
+                const bool is_selected = (item_current == n);
+                if (ImGui::Selectable(items[n], is_selected)) {
+                    item_current = n;
+                    settings.rkstages = n + 1;
+                }
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndListBox();
+        }
+    }
+    if (ImGui::CollapsingHeader("Time Step")) {
+        const char *items[] = {"Fixed", "Cell signal speeds", "Riemann wave speeds"};
+        static int item_current = 1;
+        if (ImGui::BeginListBox("Time Step")) {
+            for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
+                const bool is_selected = (item_current == n);
+                if (ImGui::Selectable(items[n], is_selected)) {
+                    item_current = n;
+                    settings.dt_type = n;
+                }
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndListBox();
+        }
+    }
+    if (ImGui::CollapsingHeader("Refinement")) {
+        bool amr = settings.amr != 0;
+        if (ImGui::Checkbox("Refine blocks", &amr)) {
+            settings.amr = amr;
+        }
+        ImGui::InputInt("amr_block", &settings.amr_block);
+        ImGui::RadioButton("Density gradient", &settings.amr_criterion, 0);
+        ImGui::SameLine();
+        ImGui::RadioButton("Interface", &settings.amr_criterion, 1);
+        ImGui::InputFloat("amr_threshold", &settings.amr_threshold);
+        ImGui::InputInt("amr_regrid", &settings.amr_regrid);
+        // The windowed programs run on a single rank, so only the block size can rule it out
+        const char *unsupported = Amr::Unsupported(1, settings.nx, settings.ny, std::max(settings.amr_block, 1));
+        if (settings.amr && unsupported != nullptr) {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Refinement stays off: %s", unsupported);
+        }
+    }
+    if (ImGui::Button("Reset")) {
+        settings.resetting++;
+    }
+    if (ImGui::Button("Play/Pause")) {
+        settings.playing = !settings.playing;
+    }
+    ImGui::SameLine();
+    ImGui::Text("Playing: %s", settings.playing ? "true" : "false");
+    if (ImGui::Button("Advance")) {
+        settings.advance++;
+    }
+    ImGui::End();
+}
@@ -0,0 +1,9 @@
+#ifndef APEP_UI_SETTINGSPANEL_H
+#define APEP_UI_SETTINGSPANEL_H
+
+#include "Settings.h"
+
+// Window with inputs for every RTSettings value and the Reset / Play / Advance controls
+void SettingsPanel(RTSettings &settings);
+
+#endif //APEP_UI_SETTINGSPANEL_H
@@ -0,0 +1,116 @@
+#include "SnapshotView.h"
+
+#include "HeatmapTexture.h"
+#include "Image.h"
+#include "Reconstruct.h"
+#include "RiemannSolver.h"
+#include "SnapshotFile.h"
+#include "Trace.h"
+
+#include "imgui.h"
+#include "implot.h"
+
+// Heatmap window height, the width follows the aspect ratio of the grid
+static constexpr float HEATMAP_HEIGHT = 640.0f;
+
+void SnapshotView(const Snapshot &snapshot, Profiler &profiler) {
+    if (snapshot.nx == 0) {
+        ImGui::Text("Waiting for the first snapshot");
+        return;
+    }
+    const int nx = snapshot.nx;
+    const int ny = snapshot.ny;
+    const ImVec2 image_size(HEATMAP_HEIGHT * nx / ny, HEATMAP_HEIGHT);
+
+    static float scale_min = 0;
+    static float scale_max = 3.0f;
+
+    static ImPlotColormap map = ImPlotColormap_Viridis;
+    if (ImPlot::ColormapButton(ImPlot::GetColormapName(map), ImVec2(225, 0), map)) {
+        map = (map + 1) % ImPlot::GetColormapCount();
+    }
+
+    ImGui::SameLine();
+    ImGui::LabelText("##Colormap Index", "%s", "Change Colormap");
+    ImGui::SetNextItemWidth(225);
+    ImGui::DragFloatRange2("Min / Max", &scale_min, &scale_max, 0.01f, -20, 20);
+    ImGui::Text("Current Time: %.3f", snapshot.time);
+    ImGui::Text("Step: %ld", snapshot.step);
+    ImGui::Text(("Current dt: %.3f"), snapshot.dt);
+    ImGui::Text("Current dlx: %.3f", snapshot.dlx);
+    ImGui::Text("Current dly: %.3f", snapshot.dly);
+    ImGui::Text("Solver threads: %d", snapshot.nthreads);
+    ImGui::Text("Tiles: %d of up to %dx%d cells", snapshot.ntiles, snapshot.tile_nx, snapshot.tile_ny);
+    ImGui::Text("Allocations in last step: %zu", snapshot.step_allocations);
+    if (snapshot.refinement > 1) {
+        ImGui::Text("Refined blocks: %d of %dx%d cells, shown at %dx", snapshot.amr_patches, snapshot.amr_block,
+                    snapshot.amr_block, snapshot.refinement);
+    }
+    if (snapshot.reconstruct_type == ReconstructType::CONSTANT) {
+        ImGui::Text("Reconstruction: Constant");
+    } else {
+        static const char *limiters[] = {"minmod", "MC", "van Leer"};
+        ImGui::Text("Reconstruction: Linear (%s)", limiters[snapshot.limiter_type]);
+    }
+
+    // Display image size
+    ImGui::Text("Image Size: %.0f x %.0f", image_size.x, image_size.y);
+    ImGui::Text("Image Grid Size: %d x %d", ny, nx);
+    if (ImGui::Button("Print Grid")) {
+        Image(0, nx, ny, snapshot.rho).Print();
+    }
+
+    static char snapshot_pattern[256] = "snapshot_{step}.apep";
+    if (ImGui::Button("Save Grid")) {
+        snapshot.Write(SnapshotFilename(snapshot_pattern, snapshot.step));
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(225);
+    ImGui::InputText("File", snapshot_pattern, sizeof(snapshot_pattern));
+
+    if (ImGui::CollapsingHeader("Riemann Solver Cost")) {
+        static const char *solvers[] = {"HLLE", "HLLC", "HLLC (SIMD)"};
+        static double cost[IM_ARRAYSIZE(solvers)] = {};
+        if (ImGui::Button("Measure")) {
+            for (int rs = 0; rs < IM_ARRAYSIZE(solvers); rs++) {
+                cost[rs] = MeasureSolveCost(rs, 4096, snapshot.gamma_ad);
+            }
+        }
+        for (int rs = 0; rs < IM_ARRAYSIZE(solvers); rs++) {
+            ImGui::Text("%-12s %6.2f ns/interface", solvers[rs], cost[rs]);
+        }
+    }
+
+    // One texture per field, uploaded only when a new snapshot is shown. Never freed, the GL
+    // objects go with the context when the app exits.
+    static const char *names[4] = {"rho", "u", "v", "en"};
+    static HeatmapTexture *heatmaps = new HeatmapTexture[4];
+    static long uploaded_step[4] = {-1, -1, -1, -1};
+    static unsigned uploaded_serial[4] = {};
+    const Field2D *fields[4] = {&snapshot.rho, &snapshot.u, &snapshot.v, &snapshot.en};
+
+    if (ImGui::BeginTabBar("Images", ImGuiTabBarFlags_None)) {
+        for (int k = 0; k < 4; k++) {
+            if (!ImGui::BeginTabItem(names[k])) {
+                continue;
+            }
+            if (uploaded_step[k] != snapshot.step || uploaded_serial[k] != snapshot.serial) {
+                ScopedPhase timer(profiler, 0, PHASE_IMAGE_UPLOAD);
+                APEP_TRACE_SCOPE("Image upload");
+                heatmaps[k].Upload(*fields[k], nx, ny);
+                uploaded_step[k] = snapshot.step;
+                uploaded_serial[k] = snapshot.serial;
+            }
+            {
+                ScopedPhase timer(profiler, 0, PHASE_HEATMAP_DRAW);
+                APEP_TRACE_SCOPE("Heatmap draw");
+                heatmaps[k].Render(map, scale_min, scale_max);
+                heatmaps[k].Draw(image_size);
+            }
+            ImGui::SameLine();
+            ImPlot::ColormapScale("##HeatScale", scale_min, scale_max, ImVec2(60, image_size.y), "%g", 0, map);
+            ImGui::EndTabItem();
+        }
+        ImGui::EndTabBar();
+    }
+}
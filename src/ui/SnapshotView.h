@@ -0,0 +1,11 @@
+#ifndef APEP_UI_SNAPSHOTVIEW_H
+#define APEP_UI_SNAPSHOTVIEW_H
+
+#include "Profiler.h"
+#include "Snapshot.h"
+
+// Draws the heatmaps and step info of a snapshot, so the UI never reads a grid that is being
+// stepped. The upload and heatmap draw go to the UI phases of profiler.
+void SnapshotView(const Snapshot &snapshot, Profiler &profiler);
+
+#endif //APEP_UI_SNAPSHOTVIEW_H
@@ -1,8 +1,6 @@
 #ifndef APEP_UTILS_SETTINGS_H
 #define APEP_UTILS_SETTINGS_H
 
-#include <imgui.h>
-
 // This header includes the various settings structs that are used in the applications
 
 struct RTSettings {
@@ -18,10 +16,19 @@ struct RTSettings {
   int resetting;
   int playing;
   int advance;
-  int cycles_per_frame;
   int reconstruct_type; // 0 for constant, 1 for linear
-  int riemann_solver_type; // 0 for HLLE, 1 for HLLC
+  int limiter_type; // Slope limiter for linear reconstruction: 0 minmod, 1 MC, 2 van Leer
+  int riemann_solver_type; // 0 for HLLE, 1 for HLLC, 2 for vectorized HLLC
   int rkstages; // Number of Runge-Kutta stages
+  int dt_type; // Time step control: 0 fixed, 1 from the cell signal speeds, 2 from the Riemann wave speeds
+  float dt_growth; // Largest factor dt may grow by from one step to the next
+  int nthreads; // Solver threads, 0 uses every hardware thread
+  int tile_nx, tile_ny; // Cells per tile, sized so a tile and its halo fit in L2
+  int amr; // Refine blocks of the grid by a factor 2 where the criterion flags them
+  int amr_block; // Cells per block side, must divide nx and ny
+  int amr_criterion; // 0 density gradient, 1 interface between the fluids
+  float amr_threshold; // Relative density jump, or mixed fraction for the interface criterion
+  int amr_regrid; // Steps between regrids
   RTSettings() {
     // Set default values
     nx = 5;
@@ -43,91 +50,20 @@ struct RTSettings {
     resetting = 0;
     playing = 0;
     advance = 0;
-    cycles_per_frame = 1;
     reconstruct_type = 1;
-    riemann_solver_type = 1;
+    limiter_type = 0;
+    riemann_solver_type = 2;
     rkstages = 2;
-  }
-
-  void Update() {
-    ImGui::Begin("RT Instability Settings", NULL, ImGuiWindowFlags_AlwaysAutoResize);
-    ImGui::InputInt("nx", &nx);
-    ImGui::InputInt("ny", &ny);
-    ImGui::InputInt("nghost", &nghost);
-    ImGui::InputFloat("rho_ini_upper", &rho_ini_upper);
-    ImGui::InputFloat("rho_ini_lower", &rho_ini_lower);
-    ImGui::InputFloat("en_ini", &en_ini);
-    ImGui::InputFloat("grav_x_init", &grav_x_ini);
-    ImGui::InputFloat("grav_y_init", &grav_y_ini);
-    ImGui::InputFloat("perturb_strength", &perturb_strength);
-    ImGui::InputFloat("x1", &x1);
-    ImGui::InputFloat("x2", &x2);
-    ImGui::InputFloat("y1", &y1);
-    ImGui::InputFloat("y2", &y2);
-    ImGui::InputFloat("tmax", &tmax);
-    ImGui::InputFloat("cfl", &cfl);
-    ImGui::InputFloat("gamma_ad", &gamma_ad);
-    ImGui::SliderInt("cycles_per_frame", &cycles_per_frame, 1, 10);
-    if (ImGui::CollapsingHeader("Reconstruction Method")) {
-      const char *items[] = {"Constant", "Linear"};
-      static int item_current = 1;
-      if (ImGui::BeginListBox("Reconstruction Method")) {
-        for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
-          const bool is_selected = (item_current == n);
-          if (ImGui::Selectable(items[n], is_selected)) {
-            item_current = n;
-            reconstruct_type = n;
-          }
-          if (is_selected)
-            ImGui::SetItemDefaultFocus();
-        }
-        ImGui::EndListBox();
-      }
-    }
-    if (ImGui::CollapsingHeader("Riemann Solver")) {
-      const char *items[] = {"HLLE", "HLLC"};
-      static int item_current = 1;
-      if (ImGui::BeginListBox("Riemann Solver")) {
-        for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
-          const bool is_selected = (item_current == n);
-          if (ImGui::Selectable(items[n], is_selected)) {
-            item_current = n;
-            riemann_solver_type = n;
-          }
-          if (is_selected)
-            ImGui::SetItemDefaultFocus();
-        }
-        ImGui::EndListBox();
-      }
-    }
-    if (ImGui::CollapsingHeader("Integrator")) {
-      const char *items[] = {"Euler", "RK2"};
-      static int item_current = 1;
-      if (ImGui::BeginListBox("Integrator")) {
-        for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
-          const bool is_selected = (item_current == n);
-          if (ImGui::Selectable(items[n], is_selected)) {
-            item_current = n;
-            rkstages = n + 1;
-          }
-          if (is_selected)
-            ImGui::SetItemDefaultFocus();
-        }
-        ImGui::EndListBox();
-      }
-    }
-    if (ImGui::Button("Reset")) {
-      resetting++;
-    }
-    if (ImGui::Button("Play/Pause")) {
-      playing = !playing;
-    }
-    ImGui::SameLine();
-    ImGui::Text("Playing: %s", playing ? "true" : "false");
-    if (ImGui::Button("Advance")) {
-      advance++;
-    }
-    ImGui::End();
+    dt_type = 1;
+    dt_growth = 1.1f;
+    nthreads = 0;
+    tile_nx = 128;
+    tile_ny = 32;
+    amr = 0;
+    amr_block = 16;
+    amr_criterion = 0;
+    amr_threshold = 0.05f;
+    amr_regrid = 4;
   }
 };
 
@@ -0,0 +1,205 @@
+#ifndef APEP_UTILS_TRACE_H
+#define APEP_UTILS_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline of what every thread did, written in the Chrome trace event format that
+// chrome://tracing and ui.perfetto.dev open. Every thread records complete events into its own
+// buffer with plain stores and one release store of the count, so recording never locks and
+// never waits for the dump. Scopes are compiled in with APEP_USE_TRACE (the CMake option
+// APEP_WITH_TRACE) and cost one relaxed load while recording is off.
+
+struct TraceEvent {
+  const char *name; // Static string, only the pointer is kept
+  int64_t start_ns; // Since the trace origin
+  int64_t duration_ns;
+  int64_t arg; // Shown as args.value, negative for none
+};
+
+// Events of one thread, appended only by that thread. Blocks are allocated as they fill and
+// never move, so a dump can read everything below the count while the thread keeps recording.
+struct TraceBuffer {
+  static constexpr int64_t BLOCK_EVENTS = 1 << 14;
+  static constexpr int64_t MAX_BLOCKS = 256; // About 4M events per thread, later ones are dropped
+
+  int tid = 0;
+  std::string thread_name; // Guarded by the Trace mutex
+  std::atomic<int64_t> count{0};
+  std::atomic<int64_t> dropped{0};
+  std::atomic<TraceEvent *> blocks[MAX_BLOCKS] = {};
+
+  TraceBuffer() = default;
+
+  TraceBuffer(const TraceBuffer &) = delete;
+
+  TraceBuffer &operator=(const TraceBuffer &) = delete;
+
+  ~TraceBuffer() {
+    for (std::atomic<TraceEvent *> &block: blocks) {
+      delete[] block.load();
+    }
+  }
+
+  void Record(const TraceEvent &event) {
+    const int64_t n = count.load(std::memory_order_relaxed);
+    if (n == BLOCK_EVENTS * MAX_BLOCKS) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    TraceEvent *block = blocks[n / BLOCK_EVENTS].load(std::memory_order_relaxed);
+    if (block == nullptr) {
+      block = new TraceEvent[BLOCK_EVENTS];
+      blocks[n / BLOCK_EVENTS].store(block, std::memory_order_release);
+    }
+    block[n % BLOCK_EVENTS] = event;
+    count.store(n + 1, std::memory_order_release);
+  }
+};
+
+struct Trace {
+  using Clock = std::chrono::steady_clock;
+
+  std::atomic<bool> recording{false};
+  const Clock::time_point origin = Clock::now();
+  std::atomic<int64_t> since_ns{0}; // Start of the recording, earlier events are not written
+
+  std::mutex mutex; // Guards the buffer list and the thread names
+  std::vector<std::unique_ptr<TraceBuffer>> buffers; // Outlive their threads
+
+  bool Recording() const {
+    return recording.load(std::memory_order_relaxed);
+  }
+
+  int64_t Now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+  }
+
+  // Events from now on are recorded, the ones before are left out of the next Write
+  void Start() {
+    since_ns.store(Now(), std::memory_order_relaxed);
+    recording.store(true, std::memory_order_relaxed);
+  }
+
+  void Stop() {
+    recording.store(false, std::memory_order_relaxed);
+  }
+
+  // Buffer of the calling thread, registered on first use
+  TraceBuffer &Local() {
+    thread_local TraceBuffer *local = nullptr;
+    if (local == nullptr) {
+      std::lock_guard<std::mutex> lock(mutex);
+      buffers.push_back(std::make_unique<TraceBuffer>());
+      local = buffers.back().get();
+      local->tid = static_cast<int>(buffers.size());
+    }
+    return *local;
+  }
+
+  void SetThreadName(const std::string &name) {
+    TraceBuffer &buffer = Local();
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer.thread_name = name;
+  }
+
+  // Writes the events recorded since Start, which may still be going on. Processes are told
+  // apart by pid, such as the MPI rank. Returns false and reports on stderr on failure.
+  bool Write(const std::string &filename, const int pid = 0) {
+    FILE *file = std::fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+      std::fprintf(stderr, "Error opening file %s\n", filename.c_str());
+      return false;
+    }
+    const int64_t since = since_ns.load(std::memory_order_relaxed);
+    int64_t dropped = 0;
+    const char *separator = "";
+    std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::unique_ptr<TraceBuffer> &buffer: buffers) {
+      if (!buffer->thread_name.empty()) {
+        std::fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                           "\"args\": {\"name\": \"%s\"}}", separator, pid, buffer->tid,
+                     buffer->thread_name.c_str());
+        separator = ",\n";
+      }
+      const int64_t n = buffer->count.load(std::memory_order_acquire);
+      for (int64_t k = 0; k < n; k++) {
+        const TraceEvent &event =
+            buffer->blocks[k / TraceBuffer::BLOCK_EVENTS].load(std::memory_order_acquire)[k % TraceBuffer::BLOCK_EVENTS];
+        if (event.start_ns < since) {
+          continue;
+        }
+        std::fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                     separator, event.name, pid, buffer->tid, event.start_ns * 1.0e-3, event.duration_ns * 1.0e-3);
+        if (event.arg >= 0) {
+          std::fprintf(file, ", \"args\": {\"value\": %lld}", static_cast<long long>(event.arg));
+        }
+        std::fprintf(file, "}");
+        separator = ",\n";
+      }
+      dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    std::fprintf(file, "\n], \"otherData\": {\"dropped_events\": %lld}}\n", static_cast<long long>(dropped));
+    if (std::fclose(file) != 0) {
+      std::fprintf(stderr, "Error writing file %s\n", filename.c_str());
+      return false;
+    }
+    return true;
+  }
+};
+
+// The one trace of the process
+inline Trace &GlobalTrace() {
+  static Trace trace;
+  return trace;
+}
+
+// Names the calling thread in the trace, even when the scopes are compiled out
+inline void TraceThreadName(const std::string &name) {
+  GlobalTrace().SetThreadName(name);
+}
+
+// Records the time from construction to destruction as one event of the calling thread
+struct TraceScope {
+  explicit TraceScope(const char *name, const int64_t arg = -1) : name(name), arg(arg) {
+    Trace &trace = GlobalTrace();
+    if (trace.Recording()) {
+      start_ns = trace.Now();
+    }
+  }
+
+  ~TraceScope() {
+    if (start_ns >= 0) {
+      Trace &trace = GlobalTrace();
+      trace.Local().Record({name, start_ns, trace.Now() - start_ns, arg});
+    }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *name;
+  int64_t arg;
+  int64_t start_ns = -1;
+};
+
+#define APEP_TRACE_CONCAT_INNER(a, b) a##b
+#define APEP_TRACE_CONCAT(a, b) APEP_TRACE_CONCAT_INNER(a, b)
+#ifdef APEP_USE_TRACE
+#define APEP_TRACE_SCOPE(name) TraceScope APEP_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define APEP_TRACE_SCOPE_ARG(name, arg) TraceScope APEP_TRACE_CONCAT(trace_scope_, __LINE__)(name, arg)
+#else
+#define APEP_TRACE_SCOPE(name) ((void) 0)
+#define APEP_TRACE_SCOPE_ARG(name, arg) ((void) 0)
+#endif
+
+#endif //APEP_UTILS_TRACE_H